@@ -0,0 +1,233 @@
+#include "../cpu/cpu.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using chip8::cpu::CPU;
+using chip8::cpu::Engine;
+using chip8::cpu::Fault;
+
+// what one rom did, written as a line of the results file
+struct Result
+{
+    bool        loaded = false;
+    uint64_t    vram_hash = 0;
+    uint64_t    cycles = 0;
+    uint64_t    faults = 0;
+    double      wall_ms = 0;
+};
+
+Result RunROM(const std::string& path, std::size_t frames, std::size_t instructions_per_frame, Engine engine, uint64_t seed)
+{
+    Result result;
+    auto start = std::chrono::steady_clock::now();
+
+    CPU cpu(engine);
+    cpu.Seed(seed);
+    result.loaded = cpu.LoadROM(path);
+
+    if (result.loaded)
+    {
+        for (std::size_t frame = 0; frame < frames; frame++)
+            result.cycles += cpu.RunFrame(instructions_per_frame).cycles;
+
+        result.vram_hash = cpu.GetVRAMHash();
+        for (std::size_t fault = 1; fault < std::size_t(Fault::Count); fault++)
+            result.faults += cpu.GetFaultCount(Fault(fault));
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.wall_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+    return result;
+}
+
+// each worker owns a deque of rom indices and takes from its back, when it
+// runs dry it steals from the front of someone else's
+class Scheduler
+{
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<std::size_t> jobs;
+    };
+
+private:
+    std::vector<Queue> queues;
+
+public:
+    Scheduler(std::size_t workers, std::size_t jobs)
+        : queues(workers)
+    {
+        // deal the jobs round robin so every worker starts with a share
+        for (std::size_t job = 0; job < jobs; job++)
+            queues[job % workers].jobs.push_back(job);
+    }
+
+    // the next job for worker, false once every queue is empty
+    bool Next(std::size_t worker, std::size_t& job)
+    {
+        if (Pop(queues[worker], job, false))
+            return true;
+
+        for (std::size_t i = 1; i < queues.size(); i++)
+        {
+            if (Pop(queues[(worker + i) % queues.size()], job, true))
+                return true;
+        }
+
+        return false;
+    }
+
+private:
+    static bool Pop(Queue& queue, std::size_t& job, bool steal)
+    {
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.jobs.empty())
+            return false;
+
+        if (steal)
+        {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+        }
+        else
+        {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+        }
+        return true;
+    }
+};
+
+// roms from the command line, an argument starting with @ names a file
+// listing one rom per line
+std::vector<std::string> CollectROMs(int argc, char** argv, int first)
+{
+    std::vector<std::string> roms;
+    for (int i = first; i < argc; i++)
+    {
+        if (argv[i][0] != '@')
+        {
+            roms.push_back(argv[i]);
+            continue;
+        }
+
+        std::ifstream list(argv[i] + 1);
+        std::string line;
+        while (std::getline(list, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                roms.push_back(line);
+        }
+    }
+    return roms;
+}
+
+// path as a quoted csv field, quotes inside it are doubled
+std::string QuoteCSV(const std::string& path)
+{
+    std::string field = "\"";
+    for (char c : path)
+    {
+        if (c == '"')
+            field += '"';
+        field += c;
+    }
+    return field + '"';
+}
+
+int Usage(const char* program)
+{
+    std::printf("usage: %s [-j threads] [-i instructions_per_frame] [-e engine] [-s seed] frames results.csv rom... | @list\n", program);
+    return 1;
+}
+
+}
+
+// usage: chip8-batch [-j threads] [-i instructions_per_frame] [-e engine] [-s seed] frames results.csv rom... | @list
+// runs every rom headless for frames frames across all cores and writes one
+// csv line per rom in the order they were given. every rom starts from the
+// same seed so runs are reproducible
+int main(int argc, char** argv)
+{
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t instructions_per_frame = 10;
+    Engine engine = Engine::Predecoded;
+    uint64_t seed = 0;
+
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        if (std::strcmp(argv[arg], "-j") == 0)
+            threads = std::max(1l, std::atol(argv[arg + 1]));
+        else if (std::strcmp(argv[arg], "-i") == 0)
+            instructions_per_frame = std::max(1l, std::atol(argv[arg + 1]));
+        else if (std::strcmp(argv[arg], "-s") == 0)
+            seed = std::strtoull(argv[arg + 1], nullptr, 0);
+        else if (std::strcmp(argv[arg], "-e") != 0 || !chip8::cpu::ParseEngine(argv[arg + 1], engine))
+            return Usage(argv[0]);
+    }
+
+    if (argc - arg < 3)
+        return Usage(argv[0]);
+
+    std::size_t frames = std::atol(argv[arg]);
+    const char* results_path = argv[arg + 1];
+    std::vector<std::string> roms = CollectROMs(argc, argv, arg + 2);
+
+    std::vector<Result> results(roms.size());
+    threads = std::min(threads, std::max<std::size_t>(roms.size(), 1));
+    Scheduler scheduler(threads, roms.size());
+
+    std::vector<std::thread> workers;
+    for (std::size_t worker = 0; worker < threads; worker++)
+    {
+        workers.emplace_back([&, worker]()
+        {
+            std::size_t job;
+            while (scheduler.Next(worker, job))
+                results[job] = RunROM(roms[job], frames, instructions_per_frame, engine, seed);
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    std::FILE* out = std::fopen(results_path, "w");
+    if (out == nullptr)
+    {
+        std::printf("couldn't open %s\n", results_path);
+        return 1;
+    }
+
+    int failed = 0;
+    std::fprintf(out, "rom,loaded,vram_hash,cycles,faults,wall_ms\n");
+    for (std::size_t i = 0; i < roms.size(); i++)
+    {
+        const Result& result = results[i];
+        std::fprintf(out, "%s,%d,%016llx,%llu,%llu,%.3f\n", QuoteCSV(roms[i]).c_str(), result.loaded,
+                     (unsigned long long)result.vram_hash, (unsigned long long)result.cycles,
+                     (unsigned long long)result.faults, result.wall_ms);
+        failed += !result.loaded;
+    }
+
+    std::fclose(out);
+    return failed == 0 ? 0 : 2;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "../cpu/cpu.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#include <x86intrin.h>
+#define CHIP8_HAS_RDTSC 1
+#endif
+
+namespace
+{
+
+using chip8::cpu::byte;
+using chip8::cpu::CPU;
+using chip8::cpu::Engine;
+
+// a loop that touches most opcode families, nothing in it prints
+const std::array<byte, 0x2a> bench_rom =
+{
+    0x60, 0x00,     // 200: v[0] = 0
+    0x61, 0x01,     // 202: v[1] = 1
+    0x62, 0x05,     // 204: v[2] = 5
+    0x80, 0x14,     // 206: v[0] += v[1]
+    0x81, 0x23,     // 208: v[1] ^= v[2]
+    0x82, 0x12,     // 20a: v[2] &= v[1]
+    0x83, 0x06,     // 20c: v[3] >>= 1
+    0x84, 0x05,     // 20e: v[4] -= v[0]
+    0x30, 0x80,     // 210: skip if v[0] == 80
+    0x42, 0x07,     // 212: skip if v[2] != 7
+    0x71, 0x03,     // 214: v[1] += 3
+    0xa3, 0x00,     // 216: I = 300
+    0xf3, 0x65,     // 218: v[0..3] = ram[I]
+    0x22, 0x26,     // 21a: call 226
+    0xf0, 0x29,     // 21c: I = font v[0]
+    0xd1, 0x25,     // 21e: draw
+    0x95, 0x60,     // 220: skip if v[5] != v[6]
+    0x12, 0x06,     // 222: jump 206
+    0x12, 0x06,     // 224: jump 206
+    0x85, 0x14,     // 226: v[5] += v[1]
+    0x00, 0xee,     // 228: return
+};
+
+struct Result
+{
+    double ns_per_instruction;
+    double cycles_per_instruction;
+};
+
+Result Run(Engine engine, long instructions)
+{
+    CPU cpu(engine);
+    cpu.LoadROM(bench_rom.data(), bench_rom.size());
+
+    // warm up caches and the predecoded slots
+    cpu.RunCycles(10000);
+
+    auto start = std::chrono::steady_clock::now();
+#ifdef CHIP8_HAS_RDTSC
+    unsigned long long start_tsc = __rdtsc();
+#endif
+
+    cpu.RunCycles(instructions);
+
+#ifdef CHIP8_HAS_RDTSC
+    unsigned long long tsc = __rdtsc() - start_tsc;
+#else
+    unsigned long long tsc = 0;
+#endif
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    Result result;
+    result.ns_per_instruction = std::chrono::duration<double, std::nano>(elapsed).count() / instructions;
+    result.cycles_per_instruction = double(tsc) / instructions;
+    return result;
+}
+
+}
+
+// usage: chip8-bench [instructions]
+int main(int argc, char** argv)
+{
+    long instructions = argc > 1 ? std::atol(argv[1]) : 50000000;
+
+    std::printf("%-12s %12s %12s\n", "engine", "ns/instr", "cycles/instr");
+    for (std::size_t e = 0; e < chip8::cpu::engine_count; e++)
+    {
+        Result result = Run(Engine(e), instructions);
+        std::printf("%-12s %12.2f %12.2f\n", chip8::cpu::EngineName(Engine(e)), result.ns_per_instruction, result.cycles_per_instruction);
+    }
+}
\ No newline at end of file
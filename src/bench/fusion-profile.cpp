@@ -0,0 +1,111 @@
+#include "../cpu/cpu.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using chip8::cpu::word;
+
+// the opcode with its operands replaced by letters, 0x6a12 -> "6XNN"
+std::string Pattern(word opcode)
+{
+    const char* digits = "0123456789ABCDEF";
+    std::string name(4, ' ');
+    name[0] = digits[opcode >> 12];
+
+    switch (opcode >> 12)
+    {
+        case 0x0:
+        case 0xe:
+        case 0xf:
+            name[1] = name[0] == '0' ? '0' : 'X';
+            name[2] = digits[(opcode >> 4) & 0xf];
+            name[3] = digits[opcode & 0xf];
+            break;
+
+        case 0x1: case 0x2: case 0xa: case 0xb:
+            name.replace(1, 3, "NNN");
+            break;
+
+        case 0x5: case 0x9:
+            name.replace(1, 3, "XY0");
+            break;
+
+        case 0x8:
+            name.replace(1, 2, "XY");
+            name[3] = digits[opcode & 0xf];
+            break;
+
+        case 0xd:
+            name.replace(1, 3, "XYN");
+            break;
+
+        default:
+            name.replace(1, 3, "XNN");
+            break;
+    }
+
+    return name;
+}
+
+void PrintTop(const char* title, const std::map<std::string, long>& counts, long total, std::size_t top)
+{
+    std::vector<std::pair<long, std::string>> sorted;
+    for (const auto& count : counts)
+        sorted.push_back({ count.second, count.first });
+    std::sort(sorted.rbegin(), sorted.rend());
+
+    std::printf("%s\n", title);
+    for (std::size_t i = 0; i < sorted.size() && i < top; i++)
+        std::printf("  %-16s %10ld %6.2f%%\n", sorted[i].second.c_str(), sorted[i].first, 100.0 * sorted[i].first / total);
+}
+
+}
+
+// usage: chip8-fusion-profile cycles rom...
+// runs each rom on the interpreter and counts which opcode pairs and triples
+// execute back to back, the most common ones are the candidates for fusion
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::printf("usage: %s cycles rom...\n", argv[0]);
+        return 1;
+    }
+
+    long cycles = std::atol(argv[1]);
+    std::map<std::string, long> pairs;
+    std::map<std::string, long> triples;
+    long total = 0;
+
+    for (int i = 2; i < argc; i++)
+    {
+        chip8::cpu::CPU cpu;
+        cpu.LoadROM(argv[i]);
+
+        std::string previous[2];
+        for (long cycle = 0; cycle < cycles; cycle++)
+        {
+            cpu.Cycle();
+            std::string current = Pattern(cpu.GetOpcode());
+
+            if (!previous[1].empty())
+                pairs[previous[1] + " " + current]++;
+            if (!previous[0].empty())
+                triples[previous[0] + " " + previous[1] + " " + current]++;
+
+            previous[0] = previous[1];
+            previous[1] = current;
+            total++;
+        }
+    }
+
+    PrintTop("pairs", pairs, total, 20);
+    PrintTop("triples", triples, total, 20);
+}
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include "cpu-batch.hpp"
+
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace chip8
+{
+namespace cpu
+{
+
+namespace
+{
+
+// 32 lanes of one register row. with avx2 these are single instructions,
+// without it they are plain loops the compiler is free to vectorize
+#ifdef __AVX2__
+
+using Bytes = __m256i;
+
+Bytes Load(const byte* row)           { return _mm256_load_si256(reinterpret_cast<const __m256i*>(row)); }
+void  Store(byte* row, Bytes value)   { _mm256_store_si256(reinterpret_cast<__m256i*>(row), value); }
+Bytes Splat(byte value)               { return _mm256_set1_epi8(char(value)); }
+Bytes Add(Bytes a, Bytes b)           { return _mm256_add_epi8(a, b); }
+Bytes Sub(Bytes a, Bytes b)           { return _mm256_sub_epi8(a, b); }
+Bytes And(Bytes a, Bytes b)           { return _mm256_and_si256(a, b); }
+Bytes Or(Bytes a, Bytes b)            { return _mm256_or_si256(a, b); }
+Bytes Xor(Bytes a, Bytes b)           { return _mm256_xor_si256(a, b); }
+Bytes AndNot(Bytes a, Bytes b)        { return _mm256_andnot_si256(b, a); }
+Bytes Equal(Bytes a, Bytes b)         { return _mm256_cmpeq_epi8(a, b); }
+Bytes ShiftRight(Bytes a)             { return _mm256_and_si256(_mm256_srli_epi16(a, 1), Splat(0x7f)); }
+Bytes ShiftLeft(Bytes a)              { return _mm256_add_epi8(a, a); }
+Bytes SubSaturate(Bytes a, Bytes b)   { return _mm256_subs_epu8(a, b); }
+
+// where mask is set b, elsewhere a
+Bytes Select(Bytes mask, Bytes a, Bytes b) { return _mm256_blendv_epi8(a, b, mask); }
+
+// unsigned a > b
+Bytes Greater(Bytes a, Bytes b)
+{
+    return AndNot(Equal(_mm256_max_epu8(a, b), a), Equal(a, b));
+}
+
+// adds amount to the words of row where mask is set
+void AddWords(word* row, Bytes mask, word amount)
+{
+    for (int half = 0; half < 2; half++)
+    {
+        __m256i* words = reinterpret_cast<__m256i*>(row) + half;
+        __m256i wide = _mm256_cvtepi8_epi16(half ? _mm256_extracti128_si256(mask, 1) : _mm256_castsi256_si128(mask));
+        __m256i value = _mm256_load_si256(words);
+        _mm256_store_si256(words, _mm256_add_epi16(value, _mm256_and_si256(wide, _mm256_set1_epi16(short(amount)))));
+    }
+}
+
+// sets the words of row where mask is set
+void SetWords(word* row, Bytes mask, word value)
+{
+    for (int half = 0; half < 2; half++)
+    {
+        __m256i* words = reinterpret_cast<__m256i*>(row) + half;
+        __m256i wide = _mm256_cvtepi8_epi16(half ? _mm256_extracti128_si256(mask, 1) : _mm256_castsi256_si128(mask));
+        _mm256_store_si256(words, _mm256_blendv_epi8(_mm256_load_si256(words), _mm256_set1_epi16(short(value)), wide));
+    }
+}
+
+#else
+
+struct Bytes
+{
+    byte lane[32];
+};
+
+template <typename F>
+Bytes Map(Bytes a, F f)
+{
+    Bytes result;
+    for (int i = 0; i < 32; i++)
+        result.lane[i] = byte(f(a.lane[i]));
+    return result;
+}
+
+template <typename F>
+Bytes Map(Bytes a, Bytes b, F f)
+{
+    Bytes result;
+    for (int i = 0; i < 32; i++)
+        result.lane[i] = byte(f(a.lane[i], b.lane[i]));
+    return result;
+}
+
+Bytes Load(const byte* row)           { Bytes result; std::copy(row, row + 32, result.lane); return result; }
+void  Store(byte* row, Bytes value)   { std::copy(value.lane, value.lane + 32, row); }
+Bytes Splat(byte value)               { Bytes result; std::fill(result.lane, result.lane + 32, value); return result; }
+Bytes Add(Bytes a, Bytes b)           { return Map(a, b, [](byte x, byte y) { return x + y; }); }
+Bytes Sub(Bytes a, Bytes b)           { return Map(a, b, [](byte x, byte y) { return x - y; }); }
+Bytes And(Bytes a, Bytes b)           { return Map(a, b, [](byte x, byte y) { return x & y; }); }
+Bytes Or(Bytes a, Bytes b)            { return Map(a, b, [](byte x, byte y) { return x | y; }); }
+Bytes Xor(Bytes a, Bytes b)           { return Map(a, b, [](byte x, byte y) { return x ^ y; }); }
+Bytes AndNot(Bytes a, Bytes b)        { return Map(a, b, [](byte x, byte y) { return x & ~y; }); }
+Bytes Equal(Bytes a, Bytes b)         { return Map(a, b, [](byte x, byte y) { return x == y ? 0xff : 0; }); }
+Bytes Greater(Bytes a, Bytes b)       { return Map(a, b, [](byte x, byte y) { return x > y ? 0xff : 0; }); }
+Bytes ShiftRight(Bytes a)             { return Map(a, [](byte x) { return x >> 1; }); }
+Bytes ShiftLeft(Bytes a)              { return Map(a, [](byte x) { return x << 1; }); }
+Bytes SubSaturate(Bytes a, Bytes b)   { return Map(a, b, [](byte x, byte y) { return x > y ? x - y : 0; }); }
+
+Bytes Select(Bytes mask, Bytes a, Bytes b)
+{
+    Bytes result;
+    for (int i = 0; i < 32; i++)
+        result.lane[i] = mask.lane[i] ? b.lane[i] : a.lane[i];
+    return result;
+}
+
+void AddWords(word* row, Bytes mask, word amount)
+{
+    for (int i = 0; i < 32; i++)
+        row[i] += mask.lane[i] ? amount : 0;
+}
+
+void SetWords(word* row, Bytes mask, word value)
+{
+    for (int i = 0; i < 32; i++)
+        row[i] = mask.lane[i] ? value : row[i];
+}
+
+#endif
+
+}
+
+template <std::size_t N>
+CPUBatch<N>::CPUBatch(Quirks quirks)
+    : quirks(quirks)
+{
+    for (auto& lane : lanes)
+        lane.SetQuirks(quirks);
+
+    for (auto& row : variable)
+        row.fill(0);
+    pc.fill(rom_start);
+    index.fill(0);
+    delay_timer.fill(0);
+    sound_timer.fill(0);
+    stack_pointer.fill(0);
+    group.fill(0);
+}
+
+// loads the same rom into every lane
+template <std::size_t N>
+void CPUBatch<N>::LoadROM(const byte* rom, std::size_t size)
+{
+    lanes[0].LoadROM(rom, size);
+
+    // the other lanes share lane 0's rom pages until they write to them
+    for (std::size_t lane = 1; lane < N; lane++)
+    {
+        lanes[lane].ram.Copy(lanes[0].ram, rom_start, lanes[0].size_of_rom);
+        lanes[lane].size_of_rom = lanes[0].size_of_rom;
+        lanes[lane].ResetCode();
+    }
+}
+
+template <std::size_t N>
+void CPUBatch<N>::SetKey(std::size_t lane, byte key, bool down)
+{
+    lanes[lane].keyboard[key & 0x0f] = down;
+}
+
+// every lane runs one instruction. the first lane leads, lanes on its pc
+// and opcode run it as rows and the rest step on their own
+template <std::size_t N>
+void CPUBatch<N>::Step()
+{
+    word leader = pc[0];
+    word opcode = lanes[0].ReadOpcode(leader);
+
+    std::size_t together = 0;
+    for (std::size_t lane = 0; lane < N; lane++)
+    {
+        bool joins = pc[lane] == leader && lanes[lane].ReadOpcode(leader) == opcode;
+        group[lane] = joins ? 0xff : 0;
+        together += joins;
+    }
+
+    if (!RunRows(opcode))
+        together = 0;
+
+    for (std::size_t lane = 0; lane < N; lane++)
+    {
+        if (together == 0 || group[lane] == 0)
+            StepLane(lane);
+    }
+
+    lockstep_lanes += together;
+    scalar_lanes += N - together;
+}
+
+template <std::size_t N>
+void CPUBatch<N>::RunCycles(std::size_t cycles)
+{
+    for (; cycles > 0; cycles--)
+        Step();
+}
+
+template <std::size_t N>
+void CPUBatch<N>::RunFrame(std::size_t instructions_per_frame)
+{
+    RunCycles(instructions_per_frame);
+    TickTimers();
+}
+
+template <std::size_t N>
+void CPUBatch<N>::TickTimers()
+{
+    for (std::size_t c = 0; c < width; c += 32)
+    {
+        Store(&delay_timer[c], SubSaturate(Load(&delay_timer[c]), Splat(1)));
+        Store(&sound_timer[c], SubSaturate(Load(&sound_timer[c]), Splat(1)));
+    }
+}
+
+// the lane's cpu with its registers brought up to date
+template <std::size_t N>
+const CPU& CPUBatch<N>::Lane(std::size_t lane)
+{
+    ToLane(lane);
+    return lanes[lane];
+}
+
+// runs opcode for every lane in group the same way the cpu's handler would,
+// false if it isn't a register only opcode
+template <std::size_t N>
+bool CPUBatch<N>::RunRows(word opcode)
+{
+    const byte x = (opcode & x_reg_mask) >> 8;
+    const byte y = (opcode & y_reg_mask) >> 4;
+    const byte nn = opcode & byte_mask;
+    const word nnn = opcode & address_mask;
+    const byte f = 0x0f;
+
+    switch (opcode & opcode_mask)
+    {
+        case 0x1000: case 0x3000: case 0x4000: case 0x5000: case 0x6000:
+        case 0x7000: case 0x9000: case 0xa000:
+            break;
+
+        case 0x8000:
+        {
+            byte n = opcode & nibble_mask;
+            if (n > 0x7 && n != 0xe)
+                return false;
+            break;
+        }
+
+        default:
+            return false;
+    }
+
+    for (std::size_t c = 0; c < width; c += 32)
+    {
+        const Bytes take = Load(&group[c]);
+        byte* vx = &variable[x][c];
+        byte* vy = &variable[y][c];
+        byte* vf = &variable[f][c];
+
+        // assigns value to a register row in the lanes taking part
+        auto set = [&](byte* row, Bytes value) { Store(row, Select(take, Load(row), value)); };
+
+        AddWords(&pc[c], take, 2);
+
+        switch (opcode & opcode_mask)
+        {
+            case 0x1000: SetWords(&pc[c], take, nnn); break;
+            case 0x3000: AddWords(&pc[c], And(take, Equal(Load(vx), Splat(nn))), 2); break;
+            case 0x4000: AddWords(&pc[c], AndNot(take, Equal(Load(vx), Splat(nn))), 2); break;
+            case 0x5000: AddWords(&pc[c], And(take, Equal(Load(vx), Load(vy))), 2); break;
+            case 0x9000: AddWords(&pc[c], AndNot(take, Equal(Load(vx), Load(vy))), 2); break;
+            case 0x6000: set(vx, Splat(nn)); break;
+            case 0x7000: set(vx, Add(Load(vx), Splat(nn))); break;
+            case 0xa000: SetWords(&index[c], take, nnn); break;
+
+            // each step reads the rows again so x or y being f behaves like the handlers
+            default:
+            {
+                switch (opcode & nibble_mask)
+                {
+                    case 0x0: set(vx, Load(vy)); break;
+                    case 0x1: set(vx, Or(Load(vx), Load(vy))); break;
+                    case 0x2: set(vx, And(Load(vx), Load(vy))); break;
+                    case 0x3: set(vx, Xor(Load(vx), Load(vy))); break;
+
+                    case 0x4:
+                    {
+                        set(vf, Splat(0));
+                        Bytes sum = Add(Load(vx), Load(vy));
+                        set(vf, And(Greater(Load(vx), sum), Splat(1)));
+                        set(vx, sum);
+                        break;
+                    }
+
+                    case 0x5:
+                        set(vf, Splat(0));
+                        set(vf, And(Greater(Load(vx), Load(vy)), Splat(1)));
+                        set(vx, Sub(Load(vx), Load(vy)));
+                        break;
+
+                    case 0x7:
+                        set(vf, Splat(0));
+                        set(vf, And(Greater(Load(vy), Load(vx)), Splat(1)));
+                        set(vx, Sub(Load(vy), Load(vx)));
+                        break;
+
+                    case 0x6:
+                        if (quirks.super_chip)
+                            set(vx, Load(vy));
+                        set(vf, And(Load(vx), Splat(1)));
+                        set(vx, ShiftRight(Load(vx)));
+                        break;
+
+                    default:
+                        if (quirks.super_chip)
+                            set(vx, Load(vy));
+                        set(vf, And(Greater(Load(vx), Splat(0x7f)), Splat(1)));
+                        set(vx, ShiftLeft(Load(vx)));
+                        break;
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+// one instruction on the lane's own cpu
+template <std::size_t N>
+void CPUBatch<N>::StepLane(std::size_t lane)
+{
+    ToLane(lane);
+    lanes[lane].Fetch();
+    lanes[lane].Decode();
+    FromLane(lane);
+}
+
+// copies the lane's column of registers into its cpu
+template <std::size_t N>
+void CPUBatch<N>::ToLane(std::size_t lane)
+{
+    Registers& registers = lanes[lane].registers;
+
+    registers.pc = pc[lane];
+    registers.index = index[lane];
+    registers.delay_timer = delay_timer[lane];
+    registers.sound_timer = sound_timer[lane];
+    registers.stack_pointer = stack_pointer[lane];
+    for (int i = 0; i < 16; i++)
+        registers.variable[i] = variable[i][lane];
+}
+
+// copies the cpu's registers back into the lane's column
+template <std::size_t N>
+void CPUBatch<N>::FromLane(std::size_t lane)
+{
+    const Registers& registers = lanes[lane].registers;
+
+    pc[lane] = registers.pc;
+    index[lane] = registers.index;
+    delay_timer[lane] = registers.delay_timer;
+    sound_timer[lane] = registers.sound_timer;
+    stack_pointer[lane] = registers.stack_pointer;
+    for (int i = 0; i < 16; i++)
+        variable[i][lane] = registers.variable[i];
+}
+
+template class CPUBatch<16>;
+template class CPUBatch<32>;
+template class CPUBatch<64>;
+
+};
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef CPU_BATCH_H
+#define CPU_BATCH_H
+
+#include "cpu.hpp"
+
+#include <array>
+#include <cstddef>
+
+namespace chip8
+{
+namespace cpu
+{
+
+// n copies of one rom run in lockstep. registers are kept structure of
+// arrays, one row per register with a byte or word per lane, so lanes that
+// sit at the same pc on the same opcode run it together. register only
+// opcodes run as whole rows (avx2 when built with it), anything else and
+// every lane that left the group steps its own cpu one instruction
+template <std::size_t N>
+class CPUBatch
+{
+private:
+    // rows are padded to whole 32 byte vectors, padding lanes never run
+    static const std::size_t width = (N + 31) / 32 * 32;
+
+    template <typename T>
+    using Row = std::array<T, width>;
+
+private:    // registers, one column per lane
+    alignas(32) std::array<Row<byte>, 16> variable;
+    alignas(32) Row<word>                 pc;
+    alignas(32) Row<word>                 index;
+    alignas(32) Row<byte>                 delay_timer;
+    alignas(32) Row<byte>                 sound_timer;
+    alignas(32) Row<byte>                 stack_pointer;
+
+    // 0xff for lanes taking part in the current lockstep opcode
+    alignas(32) Row<byte>                 group;
+
+    // ram, vram, stack and keys, the registers in here are only current
+    // while a lane steps on its own
+    std::array<CPU, N> lanes;
+    Quirks quirks;
+
+    std::size_t lockstep_lanes = 0;     // lane instructions run as rows
+    std::size_t scalar_lanes = 0;       // lane instructions run one at a time
+
+public:
+    explicit CPUBatch(Quirks quirks = Quirks());
+
+public:
+    void LoadROM(const byte* rom, std::size_t size);
+    void SetKey(std::size_t lane, byte key, bool down);
+    void Seed(std::size_t lane, uint64_t seed) { lanes[lane].Seed(seed); }
+    void Step();
+    void RunCycles(std::size_t cycles);
+    void RunFrame(std::size_t instructions_per_frame);
+    void TickTimers();
+
+    const CPU& Lane(std::size_t lane);
+    std::size_t LockstepLanes() const { return lockstep_lanes; }
+    std::size_t ScalarLanes() const { return scalar_lanes; }
+
+private:
+    bool RunRows(word opcode);
+    void StepLane(std::size_t lane);
+    void ToLane(std::size_t lane);
+    void FromLane(std::size_t lane);
+};
+
+};
+};
+
+#endif
\ No newline at end of file
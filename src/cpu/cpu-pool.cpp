@@ -0,0 +1,87 @@
+#include "cpu-pool.hpp"
+
+#include <new>
+#include <utility>
+
+namespace chip8
+{
+namespace cpu
+{
+
+CPUPool::CPUPool(std::size_t capacity)
+    : arena(capacity * Memory::page_count), slots(new Slot[capacity]), live(capacity, false), capacity(capacity)
+{
+    // lowest slots are handed out first
+    free_slots.reserve(capacity);
+    for (std::size_t i = capacity; i > 0; i--)
+        free_slots.push_back(i - 1);
+}
+
+CPUPool::~CPUPool()
+{
+    for (std::size_t i = 0; i < capacity; i++)
+    {
+        if (live[i])
+            At(i)->~CPU();
+    }
+}
+
+// a new cpu with a free slot, nullptr when the pool is full
+CPU* CPUPool::Acquire(Engine engine, Quirks quirks)
+{
+    return Construct(engine, quirks, &arena);
+}
+
+// a copy of cpu in a free slot, nullptr when the pool is full. made in the
+// slot and assigned to so its ram uses the pool's arena
+CPU* CPUPool::Clone(const CPU& cpu)
+{
+    CPU* clone = Construct(cpu.engine, cpu.quirks, &arena);
+    if (clone)
+        *clone = cpu;
+    return clone;
+}
+
+void CPUPool::Release(CPU* cpu)
+{
+    std::size_t index = IndexOf(cpu);
+    if (index >= capacity || !live[index])
+        return;
+
+    cpu->~CPU();
+    live[index] = false;
+    free_slots.push_back(index);
+}
+
+// the cpu in slot index, nullptr if the slot isn't in use
+CPU* CPUPool::At(std::size_t index)
+{
+    if (index >= capacity || !live[index])
+        return nullptr;
+    return std::launder(reinterpret_cast<CPU*>(&slots[index]));
+}
+
+std::size_t CPUPool::IndexOf(const CPU* cpu) const
+{
+    const Slot* slot = reinterpret_cast<const Slot*>(cpu);
+    if (slot < slots.get() || slot >= slots.get() + capacity)
+        return capacity;
+    return slot - slots.get();
+}
+
+template <typename... Args>
+CPU* CPUPool::Construct(Args&&... args)
+{
+    if (free_slots.empty())
+        return nullptr;
+
+    std::size_t index = free_slots.back();
+    CPU* cpu = new (&slots[index]) CPU(std::forward<Args>(args)...);
+
+    free_slots.pop_back();
+    live[index] = true;
+    return cpu;
+}
+
+};
+};
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef CPU_POOL_H
+#define CPU_POOL_H
+
+#include "cpu.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace chip8
+{
+namespace cpu
+{
+
+// a fixed number of cpus stored back to back in one allocation. slots are
+// handed out and given back without touching the allocator, so batches and
+// searches can make and drop machines as often as they like. the pages the
+// cpus write come from the pool's arena, which holds enough for all of them
+class CPUPool
+{
+private:
+    using Slot = std::aligned_storage_t<sizeof(CPU), alignof(CPU)>;
+
+private:
+    PageArena                 arena;          // outlives the cpus using it
+    std::unique_ptr<Slot[]>  slots;
+    std::vector<bool>         live;
+    std::vector<std::size_t>  free_slots;     // stack of unused slot indices
+    std::size_t               capacity;
+
+public:
+    explicit CPUPool(std::size_t capacity);
+    CPUPool(const CPUPool& pool) = delete;
+    CPUPool(CPUPool&& pool) = delete;
+    ~CPUPool();
+
+public:
+    CPU* Acquire(Engine engine = Engine::Interpreter, Quirks quirks = Quirks());
+    CPU* Clone(const CPU& cpu);
+    void Release(CPU* cpu);
+
+    std::size_t Size() const { return capacity - free_slots.size(); }
+    std::size_t Capacity() const { return capacity; }
+    CPU* At(std::size_t index);
+
+private:
+    std::size_t IndexOf(const CPU* cpu) const;
+    template <typename... Args>
+    CPU* Construct(Args&&... args);
+};
+
+};
+};
+
+#endif
\ No newline at end of file
@@ -1,425 +1,990 @@
 #include "cpu.hpp"
+#include "jit.hpp"
 
-#include <time.h>
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+
+// labels as values let every handler jump straight to the next one
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(CHIP8_NO_COMPUTED_GOTO)
+#define CHIP8_COMPUTED_GOTO 1
+#endif
 
 namespace chip8
 {
 namespace cpu
 {
 
-CPU::CPU()
+// every handler in a fixed order, the threaded interpreter's labels follow it.
+// Q marks the handlers that are templated on the quirks
+#define CHIP8_HANDLERS(X, Q) \
+    X(Op00E0) X(Op00EE) X(Op1NNN) X(Op2NNN) X(Op3XNN) X(Op4XNN) X(Op5XY0) \
+    X(Op6XNN) X(Op7XNN) X(Op8XY0) X(Op8XY1) X(Op8XY2) X(Op8XY3) X(Op8XY4) \
+    X(Op8XY5) Q(Op8XY6) X(Op8XY7) Q(Op8XYE) X(Op9XY0) X(OpANNN) Q(OpBNNN) \
+    X(OpCXNN) X(OpDXYN) X(OpEX9E) X(OpEXA1) X(OpFX07) X(OpFX0A) X(OpFX15) \
+    X(OpFX18) X(OpFX1E) X(OpFX29) X(OpFX33) Q(OpFX55) Q(OpFX65) X(OpUnknown)
+
+// quirks as compile time constants so handlers can drop the branches they don't take
+template <bool SuperChip, bool NewStoreLoad>
+struct QuirkPolicy
+{
+    static constexpr bool super_chip     = SuperChip;
+    static constexpr bool new_store_load = NewStoreLoad;
+};
+
+using DefaultQuirks = QuirkPolicy<false, true>;
+
+// wraps a handler so Dispatch can pass it around as a type
+template <void (CPU::*handler)(const Instruction& op)>
+using OpTag = std::integral_constant<void (CPU::*)(const Instruction& op), handler>;
+
+// walks the opcode tree and calls visit with the tag of the matching handler
+template <typename Q, typename Visitor>
+decltype(auto) CPU::Dispatch(word opcode, Visitor&& visit)
+{
+    switch (opcode & opcode_mask)
+    {
+        case 0x0000:
+        {
+            switch (opcode & byte_mask)
+            {
+                case 0x00e0: return visit(OpTag<&CPU::Op00E0>{});
+                case 0x00ee: return visit(OpTag<&CPU::Op00EE>{});
+                default:     return visit(OpTag<&CPU::OpUnknown>{});
+            }
+        }
+
+        case 0x1000: return visit(OpTag<&CPU::Op1NNN>{});
+        case 0x2000: return visit(OpTag<&CPU::Op2NNN>{});
+        case 0x3000: return visit(OpTag<&CPU::Op3XNN>{});
+        case 0x4000: return visit(OpTag<&CPU::Op4XNN>{});
+        case 0x5000: return visit(OpTag<&CPU::Op5XY0>{});
+        case 0x6000: return visit(OpTag<&CPU::Op6XNN>{});
+        case 0x7000: return visit(OpTag<&CPU::Op7XNN>{});
+
+        case 0x8000:
+        {
+            switch (opcode & nibble_mask)
+            {
+                case 0x0000: return visit(OpTag<&CPU::Op8XY0>{});
+                case 0x0001: return visit(OpTag<&CPU::Op8XY1>{});
+                case 0x0002: return visit(OpTag<&CPU::Op8XY2>{});
+                case 0x0003: return visit(OpTag<&CPU::Op8XY3>{});
+                case 0x0004: return visit(OpTag<&CPU::Op8XY4>{});
+                case 0x0005: return visit(OpTag<&CPU::Op8XY5>{});
+                case 0x0006: return visit(OpTag<&CPU::Op8XY6<Q>>{});
+                case 0x0007: return visit(OpTag<&CPU::Op8XY7>{});
+                case 0x000e: return visit(OpTag<&CPU::Op8XYE<Q>>{});
+                default:     return visit(OpTag<&CPU::OpUnknown>{});
+            }
+        }
+
+        case 0x9000: return visit(OpTag<&CPU::Op9XY0>{});
+        case 0xa000: return visit(OpTag<&CPU::OpANNN>{});
+        case 0xb000: return visit(OpTag<&CPU::OpBNNN<Q>>{});
+        case 0xc000: return visit(OpTag<&CPU::OpCXNN>{});
+        case 0xd000: return visit(OpTag<&CPU::OpDXYN>{});
+
+        case 0xe000:
+        {
+            switch (opcode & byte_mask)
+            {
+                case 0x9e: return visit(OpTag<&CPU::OpEX9E>{});
+                case 0xa1: return visit(OpTag<&CPU::OpEXA1>{});
+                default:   return visit(OpTag<&CPU::OpUnknown>{});
+            }
+        }
+
+        default:
+        {
+            switch (opcode & byte_mask)
+            {
+                case 0x07: return visit(OpTag<&CPU::OpFX07>{});
+                case 0x0a: return visit(OpTag<&CPU::OpFX0A>{});
+                case 0x15: return visit(OpTag<&CPU::OpFX15>{});
+                case 0x18: return visit(OpTag<&CPU::OpFX18>{});
+                case 0x1e: return visit(OpTag<&CPU::OpFX1E>{});
+                case 0x29: return visit(OpTag<&CPU::OpFX29>{});
+                case 0x33: return visit(OpTag<&CPU::OpFX33>{});
+                case 0x55: return visit(OpTag<&CPU::OpFX55<Q>>{});
+                case 0x65: return visit(OpTag<&CPU::OpFX65<Q>>{});
+                default:   return visit(OpTag<&CPU::OpUnknown>{});
+            }
+        }
+    }
+}
+
+// lets a member handler be stored as a plain function pointer
+template <CPU::Op handler>
+void CPU::Thunk(CPU& cpu, const Instruction& op)
+{
+    (cpu.*handler)(op);
+}
+
+// every quirk dependent entry point for one combination of quirks
+template <typename Q>
+CPU::Profile CPU::MakeProfile()
+{
+    Profile profile;
+    profile.decode             = &CPU::DecodeWith<Q>;
+    profile.run_threaded       = &CPU::RunThreadedWith<Q>;
+    profile.decode_instruction = &CPU::DecodeInstructionWith<Q>;
+    profile.handler_table      = &CPU::GetHandlerTable<Q>;
+    return profile;
+}
+
+const CPU::Profile& CPU::GetProfile(Quirks quirks)
+{
+    static const Profile profiles[] =
+    {
+        MakeProfile<QuirkPolicy<false, false>>(),
+        MakeProfile<QuirkPolicy<true,  false>>(),
+        MakeProfile<QuirkPolicy<false, true >>(),
+        MakeProfile<QuirkPolicy<true,  true >>()
+    };
+
+    return profiles[quirks.super_chip | (quirks.new_store_load << 1)];
+}
+
+CPU::CPU(Engine engine, Quirks quirks, PageArena* arena)
+    : ram(arena), engine(engine)
 {
+    SetQuirks(quirks);
+
+    if (engine == Engine::Jit)
+    {
+        jit.reset(new Jit());
+        jit->Attach(*this);
+    }
+
     Init();
 }
 
-// initializes internals to correct state and seeds random
+// copies share the fault callback, the jit cache isn't copied
+CPU::CPU(const CPU& cpu) = default;
+CPU::CPU(CPU&& cpu) noexcept = default;
+CPU& CPU::operator=(const CPU& cpu) = default;
+CPU& CPU::operator=(CPU&& cpu) noexcept = default;
+CPU::~CPU() = default;
+
+JitSlot::JitSlot() = default;
+JitSlot::JitSlot(const JitSlot& slot) : std::unique_ptr<Jit>(slot ? new Jit() : nullptr) {}
+JitSlot::JitSlot(JitSlot&& slot) noexcept : std::unique_ptr<Jit>(std::move(slot)) {}
+JitSlot::~JitSlot() = default;
+
+JitSlot& JitSlot::operator=(const JitSlot& slot)
+{
+    if (!slot)
+        reset();
+    else if (*this)
+        get()->Flush();
+    else
+        reset(new Jit());
+    return *this;
+}
+
+JitSlot& JitSlot::operator=(JitSlot&& slot) noexcept
+{
+    std::unique_ptr<Jit>::operator=(std::move(slot));
+    return *this;
+}
+
+// switches to the handlers specialized for quirks, anything decoded with
+// the old ones is thrown away
+void CPU::SetQuirks(Quirks quirks)
+{
+    this->quirks = quirks;
+    profile = &GetProfile(quirks);
+
+    if (engine == Engine::Table)
+        handler_table = &profile->handler_table();
+
+    ResetCode();
+}
+
+// initializes internals to correct state, random keeps its seed
 void CPU::Init()
 {
     LoadFont();
-    srand(time(nullptr));
 }
 
-void CPU::LoadROM(const std::string& rom_filename)
+// back to power on with no rom loaded, keeps the engine, quirks, fault
+// callback and seed and doesn't allocate
+void CPU::Reset()
+{
+    registers = { rom_start, 0x0000, 0x00, 0x00, { 0 }, 0x00 };
+    ram.Clear();
+    vram.fill(0);
+    stack.fill(0);
+    keyboard.fill(0);
+
+    current_opcode = 0;
+    size_of_rom = 0;
+    idle = Idle::None;
+    drew = false;
+    faulted = false;
+    dirty_rows = ~uint32_t(0);
+    dirty_columns = ~uint64_t(0);
+    ClearFaults();
+    random.Seed(random.GetSeed());
+
+    Init();
+    ResetCode();
+}
+
+static_assert(std::is_trivially_copyable<State>::value, "State must copy as bytes");
+static_assert(sizeof(State) == 4464, "State changed shape, bump state_version");
+
+// captures the machine, engine caches and fault counts aren't part of it
+void CPU::SaveState(State& state) const
+{
+    state.magic = state_magic;
+    state.version = state_version;
+    state.size = sizeof(State);
+    state.seed = random.GetSeed();
+    state.random = random.GetState();
+
+    state.pc = registers.pc;
+    state.index = registers.index;
+    state.delay_timer = registers.delay_timer;
+    state.sound_timer = registers.sound_timer;
+    state.stack_pointer = registers.stack_pointer;
+    state.quirks = quirks.super_chip | (quirks.new_store_load << 1);
+    state.variable = registers.variable;
+
+    state.current_opcode = current_opcode;
+    state.size_of_rom = size_of_rom;
+    state.stack = stack;
+    state.keyboard = keyboard;
+    ram.Read(0, state.ram.data(), state.ram.size());
+    state.vram = vram;
+    state.reserved.fill(0);
+}
+
+// false and the cpu untouched if state was saved by another version. only
+// code on ram pages that changed is decoded again, unless the quirks or the
+// rom size differ. faults and the fault callback are kept
+bool CPU::LoadState(const State& state)
+{
+    if (state.magic != state_magic || state.version != state_version || state.size != sizeof(State))
+        return false;
+
+    random.Seed(state.seed);
+    random.SetState(state.random);
+
+    registers.pc = state.pc;
+    registers.index = state.index;
+    registers.delay_timer = state.delay_timer;
+    registers.sound_timer = state.sound_timer;
+    registers.stack_pointer = std::min<std::size_t>(state.stack_pointer, stack.size());
+    registers.variable = state.variable;
+
+    Quirks saved;
+    saved.super_chip = state.quirks & 1;
+    saved.new_store_load = state.quirks & 2;
+
+    word rom_size = std::min<std::size_t>(state.size_of_rom, ram.size() - rom_start);
+    bool same_code = rom_size == size_of_rom &&
+                     saved.super_chip == quirks.super_chip && saved.new_store_load == quirks.new_store_load;
+
+    current_opcode = state.current_opcode;
+    size_of_rom = rom_size;
+    stack = state.stack;
+    keyboard = state.keyboard;
+    vram = state.vram;
+
+    for (std::size_t address = 0; address < ram.size(); address += Memory::page_size)
+    {
+        if (ram.Write(address, state.ram.data() + address, Memory::page_size) && same_code)
+            InvalidateCode(word(address), word(Memory::page_size));
+    }
+
+    idle = Idle::None;
+    drew = false;
+    faulted = false;
+
+    // anything on screen could have changed
+    dirty_rows = ~uint32_t(0);
+    dirty_columns = ~uint64_t(0);
+
+    if (!same_code)
+        SetQuirks(saved);
+    return true;
+}
+
+// false if the file couldn't be read
+bool CPU::LoadROM(const std::string& rom_filename)
 {
-    std::vector<byte> buffer;
     std::ifstream rom_file(rom_filename, std::ios::binary | std::ios::ate);
 
-    if (!rom_file.is_open())   
+    if (!rom_file.is_open())
     {
         std::cout << "ROM file wasn't opened" << std::endl;
-        return;
+        return false;
     }
 
-    buffer.resize(rom_file.tellg());
+    std::size_t size = std::size_t(rom_file.tellg());
 
-    if (buffer.empty())
+    if (size == 0)
     {
         std::cout << "ROM file is empty" << std::endl;
-        return;
+        return false;
     }
 
+    // anything past the end of ram is dropped
+    std::array<byte, Memory::size() - rom_start> rom;
+    size = std::min(size, rom.size());
     rom_file.seekg(0);
-    rom_file.read(reinterpret_cast<char*>(&ram[0x0200]), buffer.size());
+    rom_file.read(reinterpret_cast<char*>(rom.data()), size);
+
+    LoadROM(rom.data(), size);
+    return true;
+}
+
+// loads a rom that is already in memory, anything past the end of ram is dropped.
+// the rom's pages are frozen so copies of this cpu share them
+void CPU::LoadROM(const byte* rom, std::size_t size)
+{
+    size = std::min(size, ram.size() - rom_start);
+    ram.Write(rom_start, rom, size);
+    ram.Freeze();
 
-    size_of_rom = buffer.size();
+    size_of_rom = size;
+    ResetCode();
 }
 
 // runs one full cycle
 void CPU::Cycle()
 {
-    Fetch();
-    Decode();
+    switch (engine)
+    {
+        case Engine::Predecoded:
+            CyclePredecoded();
+            return;
+
+        case Engine::Table:
+            CycleTable();
+            return;
+
+        case Engine::Threaded:
+            RunThreaded(1);
+            return;
+
+        default:
+            Fetch();
+            Decode();
+            return;
+    }
 }
 
-// gets the opcode at the current value of the PC then updates PC
-void CPU::Fetch() 
+// runs the cached instruction at pc, code outside the rom is decoded as normal
+void CPU::CyclePredecoded()
 {
-    // to preserve endian-ness
-    byte high_byte = ram[registers.pc];
-    byte low_byte = ram[registers.pc + 1];
+    word slot = registers.pc - rom_start;
+    if (slot < decoded.size())
+    {
+        const Instruction& op = decoded[slot];
+        current_opcode = op.opcode;
+        registers.pc += 2;
+        op.handler(*this, op);
+        return;
+    }
 
-    current_opcode = (high_byte << 8) | low_byte;
-    
-    registers.pc += 2;
+    Fetch();
+    Decode();
 }
 
-// decides what to do based on the current opcode
-void CPU::Decode()
+// runs cycles instructions back to back. when the program is stuck in a
+// loop that can't change anything until a key or the timers do, the rest
+// of the cycles are skipped, ending in exactly the state running them would
+RunStatus CPU::RunCycles(std::size_t cycles)
 {
-    switch (current_opcode & opcode_mask)
-    {
-        case 0x0000:
-        {
-            switch (current_opcode & byte_mask)
-            {
-                case 0x00e0:    //  00e0 -> clear screen
-                    std::fill(vram.begin(), vram.end(), 0);
-                    return;
+    RunStatus status;
+    status.cycles = cycles;
 
-                case 0x00ee:    // 00ee -> return from subroutine
-                    Pop();
-                    return;
+    Idle reason = Idle::None;
+    idle = Idle::None;
+    drew = false;
+    faulted = false;
 
-                default:
-                    std::cout << "unknown opcode -- " << current_opcode << std::endl;
-                    return;
-            }
-        }
-        
-        case 0x1000:    // 1nnn -> jump to address nnn 
-        {
-            if ((current_opcode & address_mask) >= 0x1000)
-            {
-                std::cout << "attempted to jump to address " << (current_opcode & address_mask) 
-                << " which is out of bounds" << std::endl;
-                return;
-            } 
-            registers.pc = current_opcode & address_mask;
-            return;
-        }
+    while (cycles > 0)
+    {
+        cycles = RunEngine(cycles);
+        if (idle == Idle::None)
+            continue;
 
-        case 0x2000:    // 2nnn -> call subroutine at address nnn
+        // v[x] only holds the delay timer once fx07 ran in this call, so a
+        // call entered at the 3x00 or the 1nnn polls once more first
+        if (idle == Idle::WaitingForTimer && status.cycles - cycles < 3)
         {
-            if ((current_opcode & address_mask) >= 0x1000)
-            {
-                std::cout << "attempted to call subroutine at address " << (current_opcode & address_mask)
-                << " which is out of bounds";
-                return;
-            }
-            Push();
-            registers.pc = current_opcode & address_mask;
-            return;
+            idle = Idle::None;
+            continue;
         }
 
-        case 0x3000:    // 3xnn -> skip next instruction if v[x] == nn
-        {
-            if (registers.variable[GetXIndex()] == (current_opcode & byte_mask))
-                registers.pc += 2;
-            return;
-        }
+        // the timer poll is three instructions long, only skip whole passes
+        reason = idle;
+        idle = Idle::None;
+        cycles = reason == Idle::WaitingForTimer ? cycles % 3 : 0;
+    }
 
-        case 0x4000:    // 4xnn -> skip next instruction if v[x] != nn
-        {
-            if (registers.variable[GetXIndex()] != (current_opcode & byte_mask))
-                registers.pc += 2;
-            return;
-        }
+    idle = reason;
 
-        case 0x5000:    // 5xy0 -> skip next instruction if v[x] == v[y]
-        {
-            if (registers.variable[GetXIndex()] == registers.variable[GetYIndex()])
-                registers.pc += 2;
-            return;
-        }
+    status.drew = drew;
+    status.fault = faulted;
+    status.idle = idle;
+    status.waiting_for_key = idle == Idle::WaitingForKey;
+    return status;
+}
 
-        case 0x6000:    // 6xnn -> v[x] = nn
-        {   
-            registers.variable[GetXIndex()] = (current_opcode & byte_mask);
-            return;
-        }
+// one 60hz frame, runs the frame's instructions then ticks the timers
+RunStatus CPU::RunFrame(std::size_t instructions_per_frame)
+{
+    ClearDirty();
+    RunStatus status = RunCycles(instructions_per_frame);
+    TickTimers();
+    status.frame_end = true;
+    return status;
+}
 
-        case 0x7000:    // 7xnn -> v[x] += nn
-        {
-            registers.variable[GetXIndex()] += (current_opcode & byte_mask);     
-            return;
-        }
+// forgets what changed, RunFrame calls this as every frame starts
+void CPU::ClearDirty()
+{
+    dirty_rows = 0;
+    dirty_columns = 0;
+}
 
-        case 0x8000:
+// fnv-1a over the screen's 256 bytes, each row from its leftmost pixels
+// down so the hash is the same on any host. equal hashes mean equal screens
+uint64_t CPU::GetVRAMHash() const
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (auto row : vram)
+    {
+        for (int shift = 56; shift >= 0; shift -= 8)
         {
-            switch (current_opcode & nibble_mask)
-            {
-                case 0x0000:    // 8xy0 -> v[x] = v[y]
-                    registers.variable[GetXIndex()] = registers.variable[GetYIndex()];
-                    return;
-
-                case 0x0001:    // 8xy1 -> v[x] |= v[y]
-                    registers.variable[GetXIndex()] |= registers.variable[GetYIndex()];
-                    return;
-
-                case 0x0002:    // 8xy2 -> v[x] &= v[y]
-                    registers.variable[GetXIndex()] &= registers.variable[GetYIndex()];
-                    return;
-
-                case 0x0003:    // 8xy3 -> v[x] ^= v[y]
-                    registers.variable[GetXIndex()] ^= registers.variable[GetYIndex()];
-                    return;
-
-                case 0x0004:    // 8xy4 -> v[x] += v[y]
-                {
-                    registers.variable[0x0f] = 0;
-                    byte sum = registers.variable[GetXIndex()] + registers.variable[GetYIndex()];
-                    if (sum < registers.variable[GetXIndex()])
-                        registers.variable[0x0f] = 1;
-
-                    registers.variable[GetXIndex()] = sum;
-                    return;
-                }
-
-                case 0x0005:    // 8xy5 -> v[x] -= v[y]
-                {
-                    registers.variable[0x0f] = 0;
-                    if (registers.variable[GetXIndex()] > registers.variable[GetYIndex()])
-                        registers.variable[0x0f] = 1;
-
-                    registers.variable[GetXIndex()] -= registers.variable[GetYIndex()];
-                    return;
-                }
-
-                case 0x0006:    // 8xy6 -> v[x] >> 1
-                {
-                    if (super_chip)
-                        registers.variable[GetXIndex()] = registers.variable[GetYIndex()];
-                    
-                    registers.variable[0x0f] = (registers.variable[GetXIndex()] & 1);                     
-                    registers.variable[GetXIndex()] = registers.variable[GetXIndex()] >> 1;
-                    return;
-                }
-
-                case 0x0007:    // 8xy7 -> v[x] = v[y] - v[x]
-                {
-                    registers.variable[0x0f] = 0;
-                    if (registers.variable[GetYIndex()] > registers.variable[GetXIndex()])
-                        registers.variable[0x0f] = 1;
-
-                    registers.variable[GetXIndex()] = registers.variable[GetYIndex()] - registers.variable[GetXIndex()];
-                    return;
-                }
-
-                case 0x000e:    // 8xye -> v[x] << 1
-                {
-                    if (super_chip)
-                        registers.variable[GetXIndex()] = registers.variable[GetYIndex()];
-                    
-                    registers.variable[0x0f] = (registers.variable[GetXIndex()] & 128) >> 7;                     
-                    registers.variable[GetXIndex()] = registers.variable[GetXIndex()] << 1;
-                    return;
-                }
-            }
+            hash ^= (row >> shift) & 0xff;
+            hash *= 0x100000001b3;
         }
+    }
+    return hash;
+}
+
+// counts both timers down by one, called at 60hz
+void CPU::TickTimers()
+{
+    if (registers.delay_timer > 0)
+        registers.delay_timer--;
+    if (registers.sound_timer > 0)
+        registers.sound_timer--;
+}
+
+// runs up to cycles instructions on the selected engine, stopping early if
+// an idle loop is found, returns the cycles left
+std::size_t CPU::RunEngine(std::size_t cycles)
+{
+    switch (engine)
+    {
+        case Engine::Threaded:   return RunThreaded(cycles);
+        case Engine::Jit:        return RunJit(cycles);
+        case Engine::Predecoded: return RunPredecoded(cycles);
 
-        case 0x9000:    // 9xy0 -> skip next instruction if v[x] != v[y]
+        case Engine::Table:
         {
-            if (registers.variable[GetXIndex()] != registers.variable[GetYIndex()])
-                registers.pc += 2;
-            return;
+            for (; cycles > 0 && idle == Idle::None; cycles--)
+                CycleTable();
+            return cycles;
         }
 
-        case 0xa000:    // annn -> I = nnn
+        default:
         {
-            if ((current_opcode & address_mask) >= 0x1000)
+            for (; cycles > 0 && idle == Idle::None; cycles--)
             {
-                std::cout << "attempted to load address " << (current_opcode & address_mask)
-                << " into the index register which is out of bounds (" << current_opcode << ")" << std::endl;;
-                return;
+                Fetch();
+                Decode();
             }
-            
-            registers.index = current_opcode & address_mask;
+            return cycles;
         }
+    }
+}
 
-        case 0xb000:    // bnnn -> pc = nn + v[0]
+// like CyclePredecoded but runs superinstructions when there are enough
+// cycles left for all of their instructions
+std::size_t CPU::RunPredecoded(std::size_t cycles)
+{
+    while (cycles > 0 && idle == Idle::None)
+    {
+        word slot = registers.pc - rom_start;
+        if (slot < fused.size() && fused[slot].handler != nullptr && fused[slot].n <= cycles)
         {
-            if (super_chip)
-                registers.pc = (current_opcode & address_mask) + registers.variable[GetXIndex()];
-            else
-                registers.pc = (current_opcode & address_mask) + registers.variable[0];
-            return;
+            const Instruction& op = fused[slot];
+            op.handler(*this, op);
+            cycles -= fused_retired;
+            continue;
         }
 
-        case 0xc000:    // cxnn -> rng
-        {
-            registers.variable[GetXIndex()] = rand() & (current_opcode & byte_mask);
-        }
+        CyclePredecoded();
+        cycles--;
+    }
 
-        case 0xd000:    // dxyn -> draw on screen ---- needs tested
-        {
-            byte height = current_opcode & nibble_mask;
-            byte x = registers.variable[GetXIndex()] % 64;
-            byte y = registers.variable[GetYIndex()] % 32;
-            byte current_byte;
-            byte current_pixel;
-            registers.variable[0x0f] = 0;
-            
-            for (int iy = 0; iy < height; iy++)
-            {
-                if ((y + iy) > 31)
-                    break;
-
-                current_byte = ram[registers.index];
-
-                for (int ix = 0; ix < 8; ix++)
-                {
-                    if ((x + ix) > 63)
-                        break;
-
-                    current_pixel = current_byte >> (7 - ix) & 1;
-                    if (vram[((y + iy) * 32) + x + ix] && current_pixel)
-                        registers.variable[0x0f] = 1;
-                    
-                    vram[((y + iy) * 32) + x + ix] ^= current_pixel;
-                }
-            }
-            return;
-        }
+    return cycles;
+}
+
+// runs translated blocks, stepping the interpreter whenever the next block
+// is longer than the cycles left or can't be translated
+std::size_t CPU::RunJit(std::size_t cycles)
+{
+    if (!jit)
+        jit.reset(new Jit());
+    if (!jit->AttachedTo(*this))
+        jit->Attach(*this);
+
+    while (cycles > 0 && idle == Idle::None)
+    {
+        cycles = jit->Run(cycles);
+        if (cycles == 0 || idle != Idle::None)
+            break;
+
+        Fetch();
+        Decode();
+        cycles--;
+    }
+
+    return cycles;
+}
+
+// fetches then calls the handler straight out of the table
+void CPU::CycleTable()
+{
+    Fetch();
+    const Instruction op = Split(current_opcode);
+    (*handler_table)[current_opcode >> 12][current_opcode & byte_mask](*this, op);
+}
+
+// gets the opcode at the current value of the PC then updates PC
+void CPU::Fetch()
+{
+    // to preserve endian-ness
+    byte high_byte = ram.Read(registers.pc & address_mask);
+    byte low_byte = ram.Read((registers.pc + 1) & address_mask);
+
+    current_opcode = (high_byte << 8) | low_byte;
+
+    registers.pc += 2;
+}
+
+// decides what to do based on the current opcode
+void CPU::Decode()
+{
+    (this->*profile->decode)();
+}
+
+// the decode switch with the quirks fixed at compile time
+template <typename Q>
+void CPU::DecodeWith()
+{
+    const Instruction op = Split(current_opcode);
+    Dispatch<Q>(current_opcode, [&](auto handler) { (this->*decltype(handler)::value)(op); });
+}
+
+// pulls every operand out of the opcode, unused ones are ignored by the handler
+Instruction CPU::Split(word opcode)
+{
+    Instruction op;
+    op.handler = nullptr;
+    op.opcode  = opcode;
+    op.nnn     = opcode & address_mask;
+    op.x       = (opcode & x_reg_mask) >> 8;
+    op.y       = (opcode & y_reg_mask) >> 4;
+    op.nn      = opcode & byte_mask;
+    op.n       = opcode & nibble_mask;
+    return op;
+}
+
+// splits the opcode and picks its handler for the current quirks
+Instruction CPU::DecodeInstruction(word opcode) const
+{
+    return profile->decode_instruction(opcode);
+}
+
+template <typename Q>
+Instruction CPU::DecodeInstructionWith(word opcode)
+{
+    Instruction op = Split(opcode);
+    op.handler = Dispatch<Q>(opcode, [](auto handler) -> Handler { return &Thunk<decltype(handler)::value>; });
+    return op;
+}
+
+// placeholder for slots that were overwritten, decodes the slot from ram
+// again then runs it
+void CPU::Redecode(CPU& cpu, const Instruction& op)
+{
+    std::size_t slot = &op - cpu.decoded.data();
+
+    Instruction& entry = cpu.decoded[slot];
+    entry = cpu.DecodeInstruction(cpu.ReadOpcode(rom_start + slot));
+    cpu.FuseAround(slot);
+
+    cpu.current_opcode = entry.opcode;
+    entry.handler(cpu, entry);
+}
+
+std::size_t CPU::RunThreaded(std::size_t cycles)
+{
+    return (this->*profile->run_threaded)(cycles);
+}
+
+// the interpreter with a jump at the end of every handler instead of one
+// shared switch, so each handler gets its own branch history. pc and I live
+// in locals and are only written back around the handlers that use them or
+// can fault, and when the loop returns
+template <typename Q>
+std::size_t CPU::RunThreadedWith(std::size_t cycles)
+{
+#ifdef CHIP8_COMPUTED_GOTO
+#define CHIP8_LABEL(name) &&label_##name,
+    static void* const labels[] = { CHIP8_HANDLERS(CHIP8_LABEL, CHIP8_LABEL) };
+#undef CHIP8_LABEL
 
-        case 0xe000:  
+    // only touch v[], the timers and vram, and never fault
+    static constexpr std::string_view register_only[] =
+    {
+        "Op00E0", "Op6XNN", "Op7XNN", "Op8XY0", "Op8XY1", "Op8XY2", "Op8XY3", "Op8XY4",
+        "Op8XY5", "Op8XY6", "Op8XY7", "Op8XYE", "OpCXNN", "OpFX07", "OpFX15", "OpFX18"
+    };
+    auto is_register_only = [](std::string_view name)
+    {
+        for (std::string_view other : register_only)
         {
-            switch (current_opcode & byte_mask)
-            {
-                case 0x9e:  // ex9e -> skip if key v[x] is pressed
-                {
-                    if (keyboard[registers.variable[GetXIndex()]])
-                        registers.pc += 2;
-                    
-                    return;
-                }
-
-                case 0xa1:  // exa1 -> skip if key v[x] isn't pressed
-                {
-                    if (!keyboard[registers.variable[GetXIndex()]])
-                        registers.pc += 2;
-                    
-                    return;
-                }
-            }
+            if (other == name)
+                return true;
         }
+        return false;
+    };
+
+    const OpcodeClasses& classes = GetOpcodeClasses();
+    Instruction op;
+    word pc = registers.pc;
+    word index = registers.index;
+
+#define CHIP8_NEXT()                                                    \
+    if (cycles == 0 || idle != Idle::None)                              \
+    {                                                                   \
+        registers.pc = pc;                                              \
+        registers.index = index;                                        \
+        return cycles;                                                  \
+    }                                                                   \
+    cycles--;                                                           \
+    current_opcode = ReadOpcode(pc);                                    \
+    pc += 2;                                                            \
+    op = Split(current_opcode);                                         \
+    goto *labels[classes[current_opcode >> 12][current_opcode & byte_mask]]
+
+#define CHIP8_RUN(name, handler)                                        \
+    if constexpr (is_register_only(#name))                              \
+        handler(op);                                                    \
+    else                                                                \
+    {                                                                   \
+        registers.pc = pc;                                              \
+        registers.index = index;                                        \
+        handler(op);                                                    \
+        pc = registers.pc;                                              \
+        index = registers.index;                                        \
+    }
+
+    CHIP8_NEXT();
+
+#define CHIP8_BODY(name) label_##name: { CHIP8_RUN(name, name) } CHIP8_NEXT();
+#define CHIP8_QUIRK_BODY(name) label_##name: { CHIP8_RUN(name, name<Q>) } CHIP8_NEXT();
+    CHIP8_HANDLERS(CHIP8_BODY, CHIP8_QUIRK_BODY)
+#undef CHIP8_QUIRK_BODY
+#undef CHIP8_BODY
+#undef CHIP8_RUN
+#undef CHIP8_NEXT
+#else
+    for (; cycles > 0 && idle == Idle::None; cycles--)
+    {
+        Fetch();
+        DecodeWith<Q>();
+    }
+    return cycles;
+#endif
+}
 
-        case 0xf000:
+// built once per quirk combination from the decode switch so both
+// engines always agree
+template <typename Q>
+const HandlerTable& CPU::GetHandlerTable()
+{
+    static const HandlerTable table = []
+    {
+        HandlerTable table;
+        for (word family = 0; family < table.size(); family++)
+            for (word low = 0; low < table[family].size(); low++)
+                table[family][low] = DecodeInstructionWith<Q>((family << 12) | low).handler;
+        return table;
+    }();
+
+    return table;
+}
+
+// which handler runs opcode as a position in CHIP8_HANDLERS, the same for
+// every quirk setting
+byte CPU::GetOpcodeClass(word opcode)
+{
+    return GetOpcodeClasses()[opcode >> 12][opcode & byte_mask];
+}
+
+const char* CPU::GetOpcodeClassName(byte opcode_class)
+{
+#define CHIP8_NAME(name) #name,
+    static const char* const names[] = { CHIP8_HANDLERS(CHIP8_NAME, CHIP8_NAME) };
+#undef CHIP8_NAME
+
+    return opcode_class < opcode_class_count ? names[opcode_class] : "";
+}
+
+// maps every opcode to its handler's position in CHIP8_HANDLERS, the
+// positions are the same whatever the quirks are
+const CPU::OpcodeClasses& CPU::GetOpcodeClasses()
+{
+#define CHIP8_MEMBER(name) &CPU::name,
+#define CHIP8_QUIRK_MEMBER(name) &CPU::name<DefaultQuirks>,
+    static constexpr Op order[] = { CHIP8_HANDLERS(CHIP8_MEMBER, CHIP8_QUIRK_MEMBER) };
+    static_assert(std::size(order) == opcode_class_count, "opcode_class_count is out of date");
+#undef CHIP8_QUIRK_MEMBER
+#undef CHIP8_MEMBER
+
+    static const OpcodeClasses classes = []
+    {
+        OpcodeClasses classes;
+        for (word family = 0; family < classes.size(); family++)
         {
-            switch (current_opcode & byte_mask)
+            for (word low = 0; low < classes[family].size(); low++)
             {
-                case 0x07:  // fx07 -> v[x] = delay
-                    registers.variable[GetXIndex()] = registers.delay_timer;
-                    return;
-
-                case 0x15:  // fx15 -> delay = v[x]
-                    registers.delay_timer = registers.variable[GetXIndex()];
-                    return;
-
-                case 0x18:  // fx18 -> sound = v[x]
-                    registers.sound_timer = registers.variable[GetXIndex()];
-                    return;
-
-                case 0x1e:  // fx1e -> I += v[x]
-                {
-                    registers.variable[0x0f] = 0;
-                    word new_address = registers.index + registers.variable[GetXIndex()];
-                    if (new_address >= 0x1000)
-                    {
-                        std::cout << "attempted to load address " << (current_opcode & address_mask)
-                        << " into the index register which is out of bounds (" << current_opcode << ")" << std::endl;
-                        registers.variable[0x0f] = 1;   // some games rely on flag being set here
-                    }
-                    registers.index = new_address;
-                    return;
-                }
-
-                case 0x0a:  // fx0a -> wait for key to be pressed and store it
-                {
-                    for (int i = 0; i < keyboard.size(); i++)
-                    {
-                        if (keyboard[i])
-                        {
-                            registers.variable[GetXIndex()] = i;
-                            return;
-                        }
-                    }
-                    registers.pc -= 2;
-                    return;
-                }
-
-                case 0x29:  // fx29 -> loads character in v[x]
-                    registers.index = registers.variable[GetXIndex()] * 5;
-                    return;
-                
-                case 0x33:  // fx33 -> bcd of v[x]
-                {
-                    byte number = registers.variable[GetXIndex()];                    
-                    std::vector<byte> buffer;
-                    
-                    int i = 0;
-                    while (number > 0)
-                    {                   
-                        buffer.push_back(number % 10);
-                        number /= 10;
-                        i++;
-                    }
-
-                    for (struct { int i; int j;} v = {buffer.size() - 1, 0}; v.i >= 0; v.i--, v.j++)
-                    {
-                        ram[registers.index + v.j] = buffer[v.i];
-                    }
-                    return;
-                }
-                
-                case 0x55:  // fx55 -> loads v[0] to v[x] into memory at I
-                {
-                    if (new_store_load)
-                    {
-                        for (int i = 0; i <= GetXIndex(); i++)
-                        {
-                            ram[registers.index + i] = registers.variable[i];
-                        }
-                        return;
-                    }
-
-                    for (int i = 0; i <= GetXIndex(); i++)
-                    {
-                        ram[registers.index] = registers.variable[i];
-                        registers.index++;
-                    }
-                    return;                    
-                }
-
-                case 0x65:  // fx65 -> loads memory at I into v[0] to v[x]
-                {
-                    if (new_store_load)
-                    {
-                        for (int i = 0; i <= GetXIndex(); i++)
-                        {
-                            registers.variable[i] = ram[registers.index + i];
-                        }
-                        return;
-                    }
-
-                    for (int i = 0; i <= GetXIndex(); i++)
-                    {
-                        registers.variable[i] = ram[registers.index];
-                        registers.index++;
-                    }
-                    return;                    
-                }
+                Op handler = Dispatch<DefaultQuirks>((family << 12) | low, [](auto tag) { return decltype(tag)::value; });
+                classes[family][low] = std::find(std::begin(order), std::end(order), handler) - std::begin(order);
             }
         }
+        return classes;
+    }();
+
+    return classes;
+}
+
+// throws away translated blocks and decodes the whole rom again
+void CPU::ResetCode()
+{
+    if (jit)
+        jit->Flush();
+
+    if (engine != Engine::Predecoded)
+        return;
+
+    decoded.resize(size_of_rom);
+    for (std::size_t slot = 0; slot < decoded.size(); slot++)
+        decoded[slot] = DecodeInstruction(ReadOpcode(rom_start + slot));
+
+    fused.assign(size_of_rom, Instruction());
+    for (std::size_t slot = 0; slot < fused.size(); slot++)
+        Fuse(slot);
+}
+
+// called after ram is written so stale instructions aren't run, a slot
+// starting one byte before the write also reads the written byte
+void CPU::InvalidateCode(word address, word length)
+{
+    // writes past the end of ram wrap around to the start
+    address &= address_mask;
+    if (address + length > ram.size())
+    {
+        word wrapped = address + length - ram.size();
+        InvalidateCode(0, wrapped);
+        length -= wrapped;
+    }
+
+    if (jit)
+        jit->Invalidate(address, length);
+
+    if (decoded.empty())
+        return;
+
+    std::size_t first = std::max(address - rom_start - 1, 0);
+    std::size_t last  = std::min<std::size_t>(std::max(address + length - rom_start, 0), decoded.size());
+
+    for (std::size_t slot = first; slot < last; slot++)
+        decoded[slot].handler = &CPU::Redecode;
+
+    // a superinstruction reads up to three instructions from its slot on.
+    // fusing again now keeps the ones that don't reach the write, the ones
+    // that do are fused again when their slot is decoded again
+    first = std::max(address - rom_start - 5, 0);
+    for (std::size_t slot = first; slot < last; slot++)
+        Fuse(slot);
+}
+
+word CPU::ReadOpcode(word address) const
+{
+    return (ram.Read(address & address_mask) << 8) | ram.Read((address + 1) & address_mask);
+}
+
+// fx07 then 3x00 at address with the same x, looping back to it keeps
+// reading the same delay until the timer ticks
+bool CPU::IsTimerPoll(word address) const
+{
+    word load = ReadOpcode(address);
+    word test = ReadOpcode(address + 2);
+
+    return (load & 0xf0ff) == 0xf007 && (test & 0xf0ff) == 0x3000 &&
+           (load & x_reg_mask) == (test & x_reg_mask) && registers.delay_timer != 0;
+}
+
+// the pairs and triples that show up most when profiling real roms with
+// chip8-fusion-profile, all of them straight line or ending in a jump
+void CPU::Fuse(std::size_t slot)
+{
+    // what each of the next three slots holds, 0 past the end or if not decoded
+    word family[3] = { 0, 0, 0 };
+    for (std::size_t i = 0; i < 3; i++)
+    {
+        std::size_t next = slot + i * 2;
+        if (next >= decoded.size() || decoded[next].handler == &CPU::Redecode)
+            break;
+        family[i] = decoded[next].opcode & opcode_mask;
+    }
+
+    Instruction& op = fused[slot];
+    op = decoded[slot];
+
+    if (family[0] == 0x7000 && family[1] == 0x3000 && family[2] == 0x1000)
+    {
+        op.handler = &CPU::FusedCountLoop;
+        op.n = 3;
+    }
+    else if (family[0] == 0xa000 && family[1] == 0xd000)
+    {
+        op.handler = &CPU::FusedLoadDraw;
+        op.n = 2;
+    }
+    else if (family[0] == 0x6000 && family[1] == 0x6000)
+    {
+        op.handler = &CPU::FusedSetSet;
+        op.n = 2;
+    }
+    else if ((family[0] == 0x3000 || family[0] == 0x4000) && family[1] == 0x1000)
+    {
+        op.handler = &CPU::FusedSkipJump;
+        op.n = 2;
+    }
+    else
+    {
+        op.handler = nullptr;
+    }
+}
+
+// refuses every superinstruction that could include slot
+void CPU::FuseAround(std::size_t slot)
+{
+    for (std::size_t head = slot >= 4 ? slot - 4 : slot % 2; head <= slot; head += 2)
+        Fuse(head);
+}
+
+// annn, dxyn -> point I at a sprite and draw it
+void CPU::FusedLoadDraw(CPU& cpu, const Instruction& op)
+{
+    const Instruction* ops = &cpu.decoded[&op - cpu.fused.data()];
+
+    cpu.registers.pc += 4;
+    cpu.OpANNN(ops[0]);
+    cpu.OpDXYN(ops[2]);
+
+    cpu.current_opcode = ops[2].opcode;
+    cpu.fused_retired = 2;
+}
+
+// 6xnn, 6xnn -> two register loads
+void CPU::FusedSetSet(CPU& cpu, const Instruction& op)
+{
+    const Instruction* ops = &cpu.decoded[&op - cpu.fused.data()];
+
+    cpu.registers.pc += 4;
+    cpu.Op6XNN(ops[0]);
+    cpu.Op6XNN(ops[2]);
+
+    cpu.current_opcode = ops[2].opcode;
+    cpu.fused_retired = 2;
+}
+
+// 3xnn or 4xnn, 1nnn -> jump unless the skip is taken
+void CPU::FusedSkipJump(CPU& cpu, const Instruction& op)
+{
+    const Instruction* ops = &cpu.decoded[&op - cpu.fused.data()];
+    word skipped = cpu.registers.pc + 4;
+
+    cpu.registers.pc += 2;
+    cpu.current_opcode = ops[0].opcode;
+    if ((ops[0].opcode & opcode_mask) == 0x3000)
+        cpu.Op3XNN(ops[0]);
+    else
+        cpu.Op4XNN(ops[0]);
+
+    if (cpu.registers.pc == skipped)
+    {
+        cpu.fused_retired = 1;
+        return;
+    }
+
+    cpu.registers.pc += 2;
+    cpu.current_opcode = ops[2].opcode;
+    cpu.Op1NNN(ops[2]);
+    cpu.fused_retired = 2;
+}
+
+// 7xnn, 3xnn, 1nnn -> one pass of a counting loop
+void CPU::FusedCountLoop(CPU& cpu, const Instruction& op)
+{
+    const Instruction* ops = &cpu.decoded[&op - cpu.fused.data()];
+    word skipped = cpu.registers.pc + 6;
+
+    cpu.registers.pc += 4;
+    cpu.Op7XNN(ops[0]);
+    cpu.Op3XNN(ops[2]);
+    cpu.current_opcode = ops[2].opcode;
+
+    if (cpu.registers.pc == skipped)
+    {
+        cpu.fused_retired = 2;
+        return;
     }
+
+    cpu.registers.pc += 2;
+    cpu.current_opcode = ops[4].opcode;
+    cpu.Op1NNN(ops[4]);
+    cpu.fused_retired = 3;
 }
 
-// loads font set into ram
+// loads font set into ram. every cpu shares one font page unless something
+// else was already written to it
 void CPU::LoadFont()
 {
-    std::copy(fontset.begin(), fontset.end(), ram.data());
+    static PageBlock* const font_page = []()
+    {
+        Memory::Page page = {};
+        std::copy(fontset.begin(), fontset.end(), page.begin());
+        return Memory::NewSharedPage(page);
+    }();
+
+    std::array<byte, Memory::page_size - fontset.size()> rest;
+    ram.Read(fontset.size(), rest.data(), rest.size());
+
+    if (std::all_of(rest.begin(), rest.end(), [](byte value) { return value == 0; }))
+        ram.Share(0, font_page);
+    else
+        ram.Write(0, fontset.data(), fontset.size());
 }
 
 // ?x?? isolates x to get the reg_variable index
@@ -434,18 +999,434 @@ byte CPU::GetYIndex() const
     return (current_opcode & y_reg_mask) >> 4;
 }
 
-// pushes current value of pc to stack
-void CPU::Push()
+// pushes current value of pc to stack, false if it's full
+bool CPU::Push()
 {
+    if (registers.stack_pointer >= stack.size())
+        return false;
+
     stack[registers.stack_pointer] = registers.pc;
     registers.stack_pointer++;
+    return true;
 }
 
-// pops address from stack loads into pc
-void CPU::Pop()
+// pops address from stack loads into pc, false if it's empty
+bool CPU::Pop()
 {
+    if (registers.stack_pointer == 0)
+        return false;
+
     registers.stack_pointer--;
     registers.pc = stack[registers.stack_pointer];
+    return true;
+}
+
+// counts the fault and tells whoever is listening, never prints
+void CPU::Raise(Fault fault, const Instruction& op)
+{
+    fault_counts[std::size_t(fault)]++;
+    last_fault = fault;
+    faulted = true;
+
+    if (fault_callback != nullptr)
+        fault_callback(fault_user, fault, registers.pc - 2, op.opcode);
+}
+
+void CPU::SetFaultCallback(FaultCallback callback, void* user)
+{
+    fault_callback = callback;
+    fault_user = user;
+}
+
+void CPU::ClearFaults()
+{
+    fault_counts.fill(0);
+    last_fault = Fault::None;
+}
+
+const char* EngineName(Engine engine)
+{
+    switch (engine)
+    {
+        case Engine::Interpreter:   return "switch";
+        case Engine::Predecoded:    return "predecoded";
+        case Engine::Table:         return "table";
+        case Engine::Threaded:      return "threaded";
+        case Engine::Jit:           return "jit";
+        default:                    return "invalid engine";
+    }
+}
+
+bool ParseEngine(const char* name, Engine& engine)
+{
+    for (std::size_t i = 0; i < engine_count; i++)
+    {
+        if (std::strcmp(EngineName(Engine(i)), name) == 0)
+        {
+            engine = Engine(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* FaultName(Fault fault)
+{
+    switch (fault)
+    {
+        case Fault::None:           return "none";
+        case Fault::UnknownOpcode:  return "unknown opcode";
+        case Fault::IndexOverflow:  return "index overflow";
+        case Fault::StackOverflow:  return "stack overflow";
+        case Fault::StackUnderflow: return "stack underflow";
+        default:                    return "invalid fault";
+    }
+}
+
+// 00e0 -> clear screen
+void CPU::Op00E0(const Instruction&)
+{
+    for (byte row = 0; row < screen_height; row++)
+    {
+        dirty_rows |= uint32_t(vram[row] != 0) << row;
+        dirty_columns |= vram[row];
+    }
+
+    vram.fill(0);
+    drew = true;
+}
+
+// 00ee -> return from subroutine
+void CPU::Op00EE(const Instruction& op)
+{
+    if (!Pop())
+        Raise(Fault::StackUnderflow, op);
+}
+
+// 1nnn -> jump to address nnn
+void CPU::Op1NNN(const Instruction& op)
+{
+    word address = registers.pc - 2;
+    registers.pc = op.nnn;
+
+    // a jump to itself never gets out, a jump back over fx07 3x00 spins
+    // until the delay timer runs out
+    if (op.nnn == address)
+        idle = Idle::Halted;
+    else if (op.nnn == address - 4 && IsTimerPoll(op.nnn))
+        idle = Idle::WaitingForTimer;
+}
+
+// 2nnn -> call subroutine at address nnn
+void CPU::Op2NNN(const Instruction& op)
+{
+    if (!Push())
+    {
+        Raise(Fault::StackOverflow, op);
+        return;
+    }
+
+    registers.pc = op.nnn;
+}
+
+// 3xnn -> skip next instruction if v[x] == nn
+void CPU::Op3XNN(const Instruction& op)
+{
+    if (registers.variable[op.x] == op.nn)
+        registers.pc += 2;
+}
+
+// 4xnn -> skip next instruction if v[x] != nn
+void CPU::Op4XNN(const Instruction& op)
+{
+    if (registers.variable[op.x] != op.nn)
+        registers.pc += 2;
+}
+
+// 5xy0 -> skip next instruction if v[x] == v[y]
+void CPU::Op5XY0(const Instruction& op)
+{
+    if (registers.variable[op.x] == registers.variable[op.y])
+        registers.pc += 2;
+}
+
+// 6xnn -> v[x] = nn
+void CPU::Op6XNN(const Instruction& op)
+{
+    registers.variable[op.x] = op.nn;
+}
+
+// 7xnn -> v[x] += nn
+void CPU::Op7XNN(const Instruction& op)
+{
+    registers.variable[op.x] += op.nn;
+}
+
+// 8xy0 -> v[x] = v[y]
+void CPU::Op8XY0(const Instruction& op)
+{
+    registers.variable[op.x] = registers.variable[op.y];
+}
+
+// 8xy1 -> v[x] |= v[y]
+void CPU::Op8XY1(const Instruction& op)
+{
+    registers.variable[op.x] |= registers.variable[op.y];
+}
+
+// 8xy2 -> v[x] &= v[y]
+void CPU::Op8XY2(const Instruction& op)
+{
+    registers.variable[op.x] &= registers.variable[op.y];
+}
+
+// 8xy3 -> v[x] ^= v[y]
+void CPU::Op8XY3(const Instruction& op)
+{
+    registers.variable[op.x] ^= registers.variable[op.y];
+}
+
+// 8xy4 -> v[x] += v[y]
+void CPU::Op8XY4(const Instruction& op)
+{
+    registers.variable[0x0f] = 0;
+    byte sum = registers.variable[op.x] + registers.variable[op.y];
+    if (sum < registers.variable[op.x])
+        registers.variable[0x0f] = 1;
+
+    registers.variable[op.x] = sum;
+}
+
+// 8xy5 -> v[x] -= v[y]
+void CPU::Op8XY5(const Instruction& op)
+{
+    registers.variable[0x0f] = 0;
+    if (registers.variable[op.x] > registers.variable[op.y])
+        registers.variable[0x0f] = 1;
+
+    registers.variable[op.x] -= registers.variable[op.y];
+}
+
+// 8xy6 -> v[x] >> 1
+template <typename Q>
+void CPU::Op8XY6(const Instruction& op)
+{
+    if (Q::super_chip)
+        registers.variable[op.x] = registers.variable[op.y];
+
+    registers.variable[0x0f] = (registers.variable[op.x] & 1);
+    registers.variable[op.x] = registers.variable[op.x] >> 1;
+}
+
+// 8xy7 -> v[x] = v[y] - v[x]
+void CPU::Op8XY7(const Instruction& op)
+{
+    registers.variable[0x0f] = 0;
+    if (registers.variable[op.y] > registers.variable[op.x])
+        registers.variable[0x0f] = 1;
+
+    registers.variable[op.x] = registers.variable[op.y] - registers.variable[op.x];
+}
+
+// 8xye -> v[x] << 1
+template <typename Q>
+void CPU::Op8XYE(const Instruction& op)
+{
+    if (Q::super_chip)
+        registers.variable[op.x] = registers.variable[op.y];
+
+    registers.variable[0x0f] = (registers.variable[op.x] & 128) >> 7;
+    registers.variable[op.x] = registers.variable[op.x] << 1;
+}
+
+// 9xy0 -> skip next instruction if v[x] != v[y]
+void CPU::Op9XY0(const Instruction& op)
+{
+    if (registers.variable[op.x] != registers.variable[op.y])
+        registers.pc += 2;
+}
+
+// annn -> I = nnn
+void CPU::OpANNN(const Instruction& op)
+{
+    registers.index = op.nnn;
+}
+
+// bnnn -> pc = nn + v[0]
+template <typename Q>
+void CPU::OpBNNN(const Instruction& op)
+{
+    if (Q::super_chip)
+        registers.pc = op.nnn + registers.variable[op.x];
+    else
+        registers.pc = op.nnn + registers.variable[0];
+}
+
+// cxnn -> rng
+void CPU::OpCXNN(const Instruction& op)
+{
+    registers.variable[op.x] = random.Next() & op.nn;
+}
+
+// dxyn -> xors an 8 pixel wide sprite of n rows from I onto the screen at
+// v[x], v[y], v[f] is set if any pixel was turned off. the start wraps,
+// anything past the right or bottom edge is clipped
+void CPU::OpDXYN(const Instruction& op)
+{
+    byte x = registers.variable[op.x] % screen_width;
+    byte y = registers.variable[op.y] % screen_height;
+    byte rows = std::min<std::size_t>(op.n, screen_height - y);
+    uint64_t collision = 0;
+    drew = true;
+
+    // the sprite byte lands in the top 8 bits and is shifted across to x,
+    // pixels past the right edge fall off the bottom
+    for (byte row = 0; row < rows; row++)
+    {
+        uint64_t sprite = uint64_t(ram.Read((registers.index + row) & address_mask)) << (screen_width - 8) >> x;
+        collision |= vram[y + row] & sprite;
+        vram[y + row] ^= sprite;
+
+        // exactly the pixels the sprite flipped
+        dirty_rows |= uint32_t(sprite != 0) << (y + row);
+        dirty_columns |= sprite;
+    }
+
+    registers.variable[0x0f] = collision != 0;
+}
+
+// ex9e -> skip if key v[x] is pressed
+void CPU::OpEX9E(const Instruction& op)
+{
+    if (keyboard[registers.variable[op.x] & nibble_mask])
+        registers.pc += 2;
+}
+
+// exa1 -> skip if key v[x] isn't pressed
+void CPU::OpEXA1(const Instruction& op)
+{
+    if (!keyboard[registers.variable[op.x] & nibble_mask])
+        registers.pc += 2;
+}
+
+// fx07 -> v[x] = delay
+void CPU::OpFX07(const Instruction& op)
+{
+    registers.variable[op.x] = registers.delay_timer;
+}
+
+// fx0a -> wait for key to be pressed and store it
+void CPU::OpFX0A(const Instruction& op)
+{
+    for (int i = 0; i < keyboard.size(); i++)
+    {
+        if (keyboard[i])
+        {
+            registers.variable[op.x] = i;
+            return;
+        }
+    }
+    registers.pc -= 2;
+    idle = Idle::WaitingForKey;
+}
+
+// fx15 -> delay = v[x]
+void CPU::OpFX15(const Instruction& op)
+{
+    registers.delay_timer = registers.variable[op.x];
+}
+
+// fx18 -> sound = v[x]
+void CPU::OpFX18(const Instruction& op)
+{
+    registers.sound_timer = registers.variable[op.x];
+}
+
+// fx1e -> I += v[x]
+void CPU::OpFX1E(const Instruction& op)
+{
+    registers.variable[0x0f] = 0;
+    word new_address = registers.index + registers.variable[op.x];
+    if (new_address >= 0x1000)
+    {
+        Raise(Fault::IndexOverflow, op);
+        registers.variable[0x0f] = 1;   // some games rely on flag being set here
+    }
+    registers.index = new_address;
+}
+
+// fx29 -> loads character in v[x]
+void CPU::OpFX29(const Instruction& op)
+{
+    registers.index = registers.variable[op.x] * 5;
+}
+
+// fx33 -> bcd of v[x]
+void CPU::OpFX33(const Instruction& op)
+{
+    byte number = registers.variable[op.x];
+    byte digits[3];
+    int count = 0;
+
+    for (; number > 0; number /= 10)
+        digits[count++] = number % 10;
+
+    // most significant digit first, leading zeros aren't written
+    for (int i = 0; i < count; i++)
+        ram.Write((registers.index + i) & address_mask, digits[count - 1 - i]);
+
+    InvalidateCode(registers.index, 3);
+}
+
+// fx55 -> loads v[0] to v[x] into memory at I
+template <typename Q>
+void CPU::OpFX55(const Instruction& op)
+{
+    word start = registers.index;
+
+    if (Q::new_store_load)
+    {
+        for (int i = 0; i <= op.x; i++)
+        {
+            ram.Write((registers.index + i) & address_mask, registers.variable[i]);
+        }
+    }
+    else
+    {
+        for (int i = 0; i <= op.x; i++)
+        {
+            ram.Write(registers.index & address_mask, registers.variable[i]);
+            registers.index++;
+        }
+    }
+
+    InvalidateCode(start, op.x + 1);
+}
+
+// fx65 -> loads memory at I into v[0] to v[x]
+template <typename Q>
+void CPU::OpFX65(const Instruction& op)
+{
+    if (Q::new_store_load)
+    {
+        for (int i = 0; i <= op.x; i++)
+        {
+            registers.variable[i] = ram.Read((registers.index + i) & address_mask);
+        }
+        return;
+    }
+
+    for (int i = 0; i <= op.x; i++)
+    {
+        registers.variable[i] = ram.Read(registers.index & address_mask);
+        registers.index++;
+    }
+}
+
+// anything that didn't match a known opcode
+void CPU::OpUnknown(const Instruction& op)
+{
+    Raise(Fault::UnknownOpcode, op);
 }
 
 };
@@ -1,9 +1,15 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include "memory.hpp"
+#include "random.hpp"
+
 #include <cstdint>
+#include <cstddef>
 #include <array>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace chip8
 {
@@ -21,6 +27,14 @@ const word   y_reg_mask = 0x00f0;
 const word    byte_mask = 0x00ff;
 const word  nibble_mask = 0x000f;
 
+// where roms are loaded and execution starts
+const word rom_start = 0x0200;
+
+// the screen, one row per uint64_t with the leftmost pixel in the top bit
+const std::size_t screen_width = 64;
+const std::size_t screen_height = 32;
+using Framebuffer = std::array<uint64_t, screen_height>;
+
 
 
 // contains all the registers
@@ -36,44 +50,341 @@ struct Registers
 
 
 
+class CPU;
+class Jit;
+template <std::size_t N>
+class CPUBatch;
+struct Instruction;
+
+// executes one decoded instruction
+using Handler = void (*)(CPU& cpu, const Instruction& op);
+
+// an opcode split into its operands once, so executing it needs no masking
+struct Instruction
+{
+    Handler handler;
+    word     opcode;
+    word        nnn;
+    byte          x;
+    byte          y;
+    byte         nn;
+    byte          n;
+};
+
+// how the cpu executes instructions
+enum class Engine
+{
+    Interpreter,    // fetch and walk the decode switch every cycle
+    Predecoded,     // decode the rom once and execute the cached instructions
+    Table,          // fetch every cycle and look the handler up in a table
+    Threaded,       // computed goto between handlers, the interpreter where unsupported
+    Jit             // translate basic blocks to x86-64, the interpreter elsewhere
+};
+
+const std::size_t engine_count = std::size_t(Engine::Jit) + 1;
+
+// the names tools take on the command line: switch, predecoded, table,
+// threaded and jit. ParseEngine returns false for anything else
+const char* EngineName(Engine engine);
+bool ParseEngine(const char* name, Engine& engine);
+
+// why the program can't make progress, found by RunCycles
+enum class Idle : byte
+{
+    None,
+    WaitingForKey,      // fx0a with nothing pressed
+    WaitingForTimer,    // fx07 3x00 1nnn polling a running delay timer
+    Halted              // 1nnn jumping to itself
+};
+
+// what happened during a RunCycles or RunFrame call
+struct RunStatus
+{
+    std::size_t cycles     = 0;            // instructions run, skipped idle ones included
+    bool frame_end         = false;        // the timers ticked
+    bool drew              = false;        // 00e0 or dxyn touched the screen
+    bool waiting_for_key   = false;        // stopped on fx0a with nothing pressed
+    bool fault             = false;        // a fault was raised, see GetLastFault
+    Idle idle              = Idle::None;
+};
+
+// things a rom did wrong, counted on the cpu instead of printed
+enum class Fault : byte
+{
+    None,
+    UnknownOpcode,
+    IndexOverflow,      // fx1e carried I past 0xfff
+    StackOverflow,      // 2nnn with every stack slot used, the call is skipped
+    StackUnderflow,     // 00ee with nothing to return to, the return is skipped
+    Count
+};
+
+const char* FaultName(Fault fault);
+
+// called on the cpu's thread every time a fault is raised, pc is the address
+// of the instruction that faulted
+using FaultCallback = void (*)(void* user, Fault fault, word pc, word opcode);
+
+// behaviour that differs between chip8 implementations, chosen per rom
+struct Quirks
+{
+    bool     super_chip = false;    // 8xy6/8xye shift v[y] into v[x], bnnn adds v[x]
+    bool new_store_load = true;     // fx55/fx65 leave I unchanged
+};
+
+// handlers indexed by [opcode >> 12][opcode & 0xff], every family dispatches
+// on its top nibble and some part of its low byte so this covers all opcodes
+using HandlerTable = std::array<std::array<Handler, 256>, 16>;
+
+// bumped whenever State changes shape, LoadState refuses other versions
+const uint32_t state_magic   = 0x54533843;     // "C8ST"
+const uint16_t state_version = 2;
+
+// everything a rom can observe, laid out with fixed size fields and no
+// padding so it can be copied, written to disk or compared as plain bytes.
+// multi byte fields are in host order
+struct State
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;                      // sizeof(State), catches a missed version bump
+    uint64_t seed;
+    std::array<uint32_t, 4> random;
+    Framebuffer vram;
+    word pc;
+    word index;
+    byte delay_timer;
+    byte sound_timer;
+    byte stack_pointer;
+    byte quirks;                        // bit 0 super_chip, bit 1 new_store_load
+    std::array<byte, 16> variable;
+    word current_opcode;
+    word size_of_rom;
+    std::array<word, 16> stack;
+    std::array<byte, 16> keyboard;
+    std::array<byte, 0x1000> ram;
+    std::array<byte, 4> reserved;       // keeps the size a multiple of 8
+};
+
+
+
+// owns the cpu's jit. translated code points into the cpu it was made for,
+// so copies get an empty jit of their own and moves take the jit along. the
+// jit engine attaches it to its cpu, dropping its blocks, the first time it
+// runs there, so neither has to allocate once the cpu is running
+struct JitSlot : std::unique_ptr<Jit>
+{
+    JitSlot();
+    JitSlot(const JitSlot& slot);
+    JitSlot(JitSlot&& slot) noexcept;
+    JitSlot& operator=(const JitSlot& slot);
+    JitSlot& operator=(JitSlot&& slot) noexcept;
+    ~JitSlot();
+};
+
+
+
 class CPU
 {
 private:    // internal components
     Registers             registers = { 0x0200, 0x0000, 0x00,
                                         0x00,   { 0 },  0x00};
-    std::array<byte, 0x1000>    ram = { 0 };
-    std::array<byte, 64 * 32>  vram = { 0 };
+    Memory                      ram;
+    Framebuffer                vram = { 0 };
     std::array<word, 16>      stack = { 0 };
     std::array<byte, 16>   keyboard = { 0 };
 
 private:    // private data
     word current_opcode = 0;
     word    size_of_rom = 0;
-    bool     super_chip = 0;
-    bool new_store_load = 1;
+    Quirks       quirks;
+    Engine       engine = Engine::Interpreter;
+
+    // entry points specialized for the current quirks
+    struct Profile
+    {
+        void (CPU::*decode)();
+        std::size_t (CPU::*run_threaded)(std::size_t cycles);
+        Instruction (*decode_instruction)(word opcode);
+        const HandlerTable& (*handler_table)();
+    };
+    const Profile*      profile = nullptr;
+    const HandlerTable* handler_table = nullptr;
+
+    // one entry per rom byte, indexed by pc - rom_start, empty when not predecoding
+    std::vector<Instruction> decoded;
+
+    // superinstructions starting at the same slots as decoded, a null handler
+    // means nothing was fused there. n holds the most instructions it can run
+    std::vector<Instruction> fused;
+    byte fused_retired = 0;     // instructions the last superinstruction ran
+
+    Random random;              // cxnn, per cpu so runs are reproducible
+
+    Idle idle = Idle::None;
+    bool drew = false;          // set by handlers, reset by RunCycles
+    bool faulted = false;
+
+    // rows and columns of the screen changed since the last frame started,
+    // bit y of rows and bit 63 - x of columns like the vram rows
+    uint32_t dirty_rows = 0;
+    uint64_t dirty_columns = 0;
+
+    // faults raised since the last ClearFaults
+    std::array<uint32_t, std::size_t(Fault::Count)> fault_counts = { 0 };
+    Fault      last_fault = Fault::None;
+    FaultCallback fault_callback = nullptr;
+    void*      fault_user = nullptr;
+
+    // translated blocks, only created for Engine::Jit
+    JitSlot jit;
+    friend class Jit;
+    friend class CPUPool;
+    template <std::size_t N>
+    friend class CPUBatch;
 
 public:     // constructors and destructors
-    CPU();
-    CPU(const CPU& cpu) = delete;
-    CPU(CPU&& cpu) = delete;
-    virtual ~CPU() = default;
+    // ram takes the pages it writes from arena, the default one when it's nullptr
+    explicit CPU(Engine engine = Engine::Interpreter, Quirks quirks = Quirks(), PageArena* arena = nullptr);
+    CPU(const CPU& cpu);
+    CPU(CPU&& cpu) noexcept;
+    CPU& operator=(const CPU& cpu);
+    CPU& operator=(CPU&& cpu) noexcept;
+    virtual ~CPU();
 
 public:     // public functions
     void Init();
-    void LoadROM(const std::string& rom_filename);
+    void Reset();
+    void Seed(uint64_t seed) { random.Seed(seed); }
+    uint64_t GetSeed() const { return random.GetSeed(); }
+    void SetQuirks(Quirks quirks);
+    void SaveState(State& state) const;
+    bool LoadState(const State& state);
+    bool LoadROM(const std::string& rom_filename);
+    void LoadROM(const byte* rom, std::size_t size);
     void Cycle();
+    RunStatus RunCycles(std::size_t cycles);
+    RunStatus RunFrame(std::size_t instructions_per_frame);
+    void TickTimers();
+    void SetKey(byte key, bool down) { keyboard[key & nibble_mask] = down; }
+    word GetOpcode() const { return current_opcode; }
+    const Registers& GetRegisters() const { return registers; }
+    const Memory& GetRAM() const { return ram; }
+    Idle GetIdle() const { return idle; }
+    const Framebuffer& GetVRAM() const { return vram; }
+    bool GetPixel(std::size_t x, std::size_t y) const { return (vram[y] >> (screen_width - 1 - x)) & 1; }
+    uint32_t GetDirtyRows() const { return dirty_rows; }
+    uint64_t GetDirtyColumns() const { return dirty_columns; }
+    void ClearDirty();
+    uint64_t GetVRAMHash() const;
+    void SetFaultCallback(FaultCallback callback, void* user);
+    uint32_t GetFaultCount(Fault fault) const { return fault_counts[std::size_t(fault)]; }
+    Fault GetLastFault() const { return last_fault; }
+    void ClearFaults();
+
+    // handlers numbered in a fixed order, for coverage and profiling
+    static const std::size_t opcode_class_count = 35;
+    static byte GetOpcodeClass(word opcode);
+    static const char* GetOpcodeClassName(byte opcode_class);
 
 private:    // private functions
     void Fetch();
     void Decode();
+    template <typename Q>
+    void DecodeWith();
+    void CyclePredecoded();
+    std::size_t RunEngine(std::size_t cycles);
+    std::size_t RunPredecoded(std::size_t cycles);
+    void CycleTable();
+    std::size_t RunThreaded(std::size_t cycles);
+    template <typename Q>
+    std::size_t RunThreadedWith(std::size_t cycles);
+    std::size_t RunJit(std::size_t cycles);
     void LoadFont();
     byte GetXIndex() const;
     byte GetYIndex() const;
-    void Push();
-    void Pop();
-    
+    bool Push();
+    bool Pop();
+    void Raise(Fault fault, const Instruction& op);
+
+private:    // decoding
+    using Op = void (CPU::*)(const Instruction& op);
+
+    template <typename Q, typename Visitor>
+    static decltype(auto) Dispatch(word opcode, Visitor&& visit);
+    template <Op handler>
+    static void Thunk(CPU& cpu, const Instruction& op);
+    static Instruction Split(word opcode);
+    Instruction DecodeInstruction(word opcode) const;
+    template <typename Q>
+    static Instruction DecodeInstructionWith(word opcode);
+    static void Redecode(CPU& cpu, const Instruction& op);
+    template <typename Q>
+    static const HandlerTable& GetHandlerTable();
+    template <typename Q>
+    static Profile MakeProfile();
+    static const Profile& GetProfile(Quirks quirks);
+
+    // position of each opcode's handler in the threaded interpreter's label list
+    using OpcodeClasses = std::array<std::array<byte, 256>, 16>;
+    static const OpcodeClasses& GetOpcodeClasses();
+    void ResetCode();
+    void InvalidateCode(word address, word length);
+    word ReadOpcode(word address) const;
+    bool IsTimerPoll(word address) const;
+
+private:    // superinstructions
+    void Fuse(std::size_t slot);
+    void FuseAround(std::size_t slot);
+    static void FusedLoadDraw(CPU& cpu, const Instruction& op);
+    static void FusedSetSet(CPU& cpu, const Instruction& op);
+    static void FusedSkipJump(CPU& cpu, const Instruction& op);
+    static void FusedCountLoop(CPU& cpu, const Instruction& op);
+
+private:    // opcode handlers
+    void Op00E0(const Instruction& op);
+    void Op00EE(const Instruction& op);
+    void Op1NNN(const Instruction& op);
+    void Op2NNN(const Instruction& op);
+    void Op3XNN(const Instruction& op);
+    void Op4XNN(const Instruction& op);
+    void Op5XY0(const Instruction& op);
+    void Op6XNN(const Instruction& op);
+    void Op7XNN(const Instruction& op);
+    void Op8XY0(const Instruction& op);
+    void Op8XY1(const Instruction& op);
+    void Op8XY2(const Instruction& op);
+    void Op8XY3(const Instruction& op);
+    void Op8XY4(const Instruction& op);
+    void Op8XY5(const Instruction& op);
+    template <typename Q>
+    void Op8XY6(const Instruction& op);
+    void Op8XY7(const Instruction& op);
+    template <typename Q>
+    void Op8XYE(const Instruction& op);
+    void Op9XY0(const Instruction& op);
+    void OpANNN(const Instruction& op);
+    template <typename Q>
+    void OpBNNN(const Instruction& op);
+    void OpCXNN(const Instruction& op);
+    void OpDXYN(const Instruction& op);
+    void OpEX9E(const Instruction& op);
+    void OpEXA1(const Instruction& op);
+    void OpFX07(const Instruction& op);
+    void OpFX0A(const Instruction& op);
+    void OpFX15(const Instruction& op);
+    void OpFX18(const Instruction& op);
+    void OpFX1E(const Instruction& op);
+    void OpFX29(const Instruction& op);
+    void OpFX33(const Instruction& op);
+    template <typename Q>
+    void OpFX55(const Instruction& op);
+    template <typename Q>
+    void OpFX65(const Instruction& op);
+    void OpUnknown(const Instruction& op);
+
 private:    //fontset
-    const std::array<byte, 80> fontset =
+    static constexpr std::array<byte, 80> fontset =
     {
         0xF0, 0x90, 0x90, 0x90, 0xF0, //0
         0x20, 0x60, 0x20, 0x20, 0x70, //1
@@ -0,0 +1,78 @@
+#include "fault-log.hpp"
+
+#include <chrono>
+#include <cstdio>
+
+namespace chip8
+{
+namespace cpu
+{
+
+FaultLog::FaultLog(std::ostream& out)
+    : out(out)
+{
+    writer = std::thread(&FaultLog::Write, this);
+}
+
+// writes whatever is still queued before returning
+FaultLog::~FaultLog()
+{
+    running.store(false, std::memory_order_release);
+    writer.join();
+    Drain();
+    out.flush();
+}
+
+void FaultLog::Attach(CPU& cpu)
+{
+    cpu.SetFaultCallback(&FaultLog::Record, this);
+}
+
+// the fault callback, only queues the fault
+void FaultLog::Record(void* log, Fault fault, word pc, word opcode)
+{
+    FaultLog& self = *static_cast<FaultLog*>(log);
+    std::size_t head = self.head.load(std::memory_order_relaxed);
+
+    if (head - self.tail.load(std::memory_order_acquire) == capacity)
+    {
+        self.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    self.entries[head % capacity] = { fault, pc, opcode };
+    self.head.store(head + 1, std::memory_order_release);
+}
+
+// writes every queued fault, false if there was nothing to write
+bool FaultLog::Drain()
+{
+    std::size_t tail = this->tail.load(std::memory_order_relaxed);
+    std::size_t head = this->head.load(std::memory_order_acquire);
+    if (tail == head)
+        return false;
+
+    char line[64];
+    for (; tail != head; tail++)
+    {
+        const Entry& entry = entries[tail % capacity];
+        std::snprintf(line, sizeof(line), "%03x: %04x %s\n", entry.pc, entry.opcode, FaultName(entry.fault));
+        out << line;
+        this->tail.store(tail + 1, std::memory_order_release);
+    }
+
+    out.flush();
+    return true;
+}
+
+void FaultLog::Write()
+{
+    while (running.load(std::memory_order_acquire))
+    {
+        if (!Drain())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+};
+};
\ No newline at end of file
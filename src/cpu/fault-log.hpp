@@ -0,0 +1,60 @@
+#ifndef FAULT_LOG_H
+#define FAULT_LOG_H
+
+#include "cpu.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <thread>
+
+namespace chip8
+{
+namespace cpu
+{
+
+// writes faults to a stream from its own thread so the cpu never waits on
+// io. one cpu feeds one log, when the queue is full new faults are dropped
+// and counted
+class FaultLog
+{
+private:
+    struct Entry
+    {
+        Fault  fault;
+        word      pc;
+        word  opcode;
+    };
+
+    static const std::size_t capacity = 1024;
+
+private:
+    std::ostream& out;
+    std::array<Entry, capacity> entries;
+    std::atomic<std::size_t> head = { 0 };     // next slot the cpu writes
+    std::atomic<std::size_t> tail = { 0 };     // next slot the writer reads
+    std::atomic<std::size_t> dropped = { 0 };
+    std::atomic<bool>        running = { true };
+    std::thread             writer;
+
+public:
+    explicit FaultLog(std::ostream& out);
+    FaultLog(const FaultLog& log) = delete;
+    FaultLog(FaultLog&& log) = delete;
+    ~FaultLog();
+
+public:
+    void Attach(CPU& cpu);
+    std::size_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+    static void Record(void* log, Fault fault, word pc, word opcode);
+
+private:
+    bool Drain();
+    void Write();
+};
+
+};
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include "jit.hpp"
+
+#include <cstddef>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace chip8
+{
+namespace cpu
+{
+
+// worst case bytes for one instruction, two stores and a call
+const std::size_t max_instruction_bytes = 64;
+
+Jit::Jit()
+{
+#ifdef CHIP8_JIT_X64
+// mapped writable but not executable, Translate flips the pages it writes
+#ifdef _WIN32
+    code = static_cast<byte*>(VirtualAlloc(nullptr, code_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+    void* memory = mmap(nullptr, code_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    code = memory == MAP_FAILED ? nullptr : static_cast<byte*>(memory);
+#endif
+#endif
+
+    records.reserve(max_records);
+}
+
+Jit::~Jit()
+{
+#ifdef CHIP8_JIT_X64
+    if (code == nullptr)
+        return;
+#ifdef _WIN32
+    VirtualFree(code, 0, MEM_RELEASE);
+#else
+    munmap(code, code_size);
+#endif
+#endif
+}
+
+// runs cached blocks back to back, stops when the next one doesn't fit in
+// cycles, can't be translated or the cpu went idle and returns the cycles
+// left for the caller
+std::size_t Jit::Run(std::size_t cycles)
+{
+    while (cycles > 0 && cpu->idle == Idle::None)
+    {
+        word pc = cpu->registers.pc;
+        if (pc >= blocks.size() - 1)
+            return cycles;
+
+        const Block* block = &blocks[pc];
+        if (block->code == nullptr)
+            block = Translate(pc);
+
+        if (block == nullptr || block->length > cycles)
+            return cycles;
+
+        // the block can flush the cache by writing to itself so read this first
+        word length = block->length;
+        block->code();
+        cycles -= length;
+    }
+
+    return cycles;
+}
+
+// drops every block if ram that was translated is written
+void Jit::Invalidate(word address, word length)
+{
+    for (std::size_t i = address; i < std::size_t(address) + length && i < covered.size(); i++)
+    {
+        if (covered[i])
+        {
+            Flush();
+            return;
+        }
+    }
+}
+
+// translates for cpu from now on, blocks made for another cpu are dropped
+void Jit::Attach(CPU& cpu)
+{
+    this->cpu = &cpu;
+    Flush();
+}
+
+// forgets all blocks, the memory is reused so code that is running stays valid
+void Jit::Flush()
+{
+    code_used = 0;
+    records.clear();
+    blocks.fill({ nullptr, 0 });
+    covered.reset();
+}
+
+// control transfers end a block, so do ram writes since they could change
+// the code that follows them
+bool Jit::EndsBlock(word opcode)
+{
+    switch (opcode & opcode_mask)
+    {
+        case 0x0000: return (opcode & byte_mask) == 0xee;
+        case 0x1000:
+        case 0x2000:
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+        case 0xb000:
+        case 0xe000: return true;
+        case 0xf000:
+        {
+            word low = opcode & byte_mask;
+            return low == 0x0a || low == 0x33 || low == 0x55;
+        }
+        default:     return false;
+    }
+}
+
+// builds the block starting at pc, nullptr if there is no executable memory
+const Jit::Block* Jit::Translate(word pc)
+{
+    if (code == nullptr)
+        return nullptr;
+
+    if (code_size - code_used < (max_block_length + 2) * max_instruction_bytes ||
+        records.size() + max_block_length > max_records)
+        Flush();
+
+    // the code memory is never writable and executable at once, the pages
+    // this block lands on are writable only until it's emitted
+    byte* start = code + code_used;
+    std::size_t most = (max_block_length + 2) * max_instruction_bytes;
+    if (!Protect(start, most, true))
+        return nullptr;
+
+    EmitPrologue();
+
+    word address = pc;
+    word length = 0;
+    word opcode = 0;
+    bool state_stored = false;
+
+    while (length < max_block_length && std::size_t(address) + 1 < cpu->ram.size())
+    {
+        opcode = (cpu->ram.Read(address) << 8) | cpu->ram.Read(address + 1);
+        Instruction op = cpu->DecodeInstruction(opcode);
+
+        covered.set(address);
+        covered.set(address + 1);
+        address += 2;
+        length++;
+
+        // handlers can read pc so it has to be right before calling one,
+        // inline ops don't care and it's stored once at the end instead
+        state_stored = !EmitInline(op);
+        if (state_stored)
+        {
+            EmitStore16(&cpu->registers.pc, address);
+            EmitStore16(&cpu->current_opcode, opcode);
+            EmitCall(op);
+        }
+
+        if (EndsBlock(opcode))
+            break;
+    }
+
+    if (!state_stored)
+    {
+        EmitStore16(&cpu->registers.pc, address);
+        EmitStore16(&cpu->current_opcode, opcode);
+    }
+
+    EmitEpilogue();
+
+    if (!Protect(start, most, false))
+        return nullptr;
+
+    blocks[pc] = { reinterpret_cast<BlockFunction>(start), length };
+    return &blocks[pc];
+}
+
+// makes the pages under length bytes at start read write or read execute,
+// false if the os refused
+bool Jit::Protect(byte* start, std::size_t length, bool writable)
+{
+    const std::size_t page = 0x1000;
+    std::size_t first = std::size_t(start - code) / page * page;
+    std::size_t last = std::size_t(start - code) + length;
+    if (last > code_size)
+        last = code_size;
+
+#ifdef _WIN32
+    DWORD old;
+    if (!VirtualProtect(code + first, last - first, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &old))
+        return false;
+    return writable || FlushInstructionCache(GetCurrentProcess(), start, length);
+#else
+    return mprotect(code + first, last - first, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+void Jit::Emit8(byte value)
+{
+    code[code_used++] = value;
+}
+
+void Jit::Emit16(word value)
+{
+    Emit8(value & 0xff);
+    Emit8(value >> 8);
+}
+
+void Jit::Emit64(uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        Emit8((value >> (i * 8)) & 0xff);
+}
+
+// push rbx, keep the stack aligned with shadow space for win64, rbx = &registers
+void Jit::EmitPrologue()
+{
+    Emit8(0x53);
+    Emit8(0x48); Emit8(0x83); Emit8(0xec); Emit8(0x20);
+    Emit8(0x48); Emit8(0xbb); Emit64(reinterpret_cast<uint64_t>(&cpu->registers));
+}
+
+void Jit::EmitEpilogue()
+{
+    Emit8(0x48); Emit8(0x83); Emit8(0xc4); Emit8(0x20);
+    Emit8(0x5b);
+    Emit8(0xc3);
+}
+
+// writes ops that only touch registers directly against [rbx + offset],
+// returns false if the op needs its handler
+bool Jit::EmitInline(const Instruction& op)
+{
+    const byte modrm_rbx_disp8 = 0x43;
+    byte vx = offsetof(Registers, variable) + op.x;
+    byte vy = offsetof(Registers, variable) + op.y;
+
+    switch (op.opcode & opcode_mask)
+    {
+        case 0x6000:    // mov byte [v[x]], nn
+            Emit8(0xc6); Emit8(modrm_rbx_disp8); Emit8(vx); Emit8(op.nn);
+            return true;
+
+        case 0x7000:    // add byte [v[x]], nn
+            Emit8(0x80); Emit8(modrm_rbx_disp8); Emit8(vx); Emit8(op.nn);
+            return true;
+
+        case 0x8000:
+        {
+            // mov/or/and/xor byte [v[x]], al
+            const byte ops[] = { 0x88, 0x08, 0x20, 0x30 };
+            if (op.n > 3)
+                return false;
+
+            Emit8(0x8a); Emit8(modrm_rbx_disp8); Emit8(vy);     // mov al, byte [v[y]]
+            Emit8(ops[op.n]); Emit8(modrm_rbx_disp8); Emit8(vx);
+            return true;
+        }
+
+        case 0xa000:    // mov word [index], nnn
+            Emit8(0x66); Emit8(0xc7); Emit8(modrm_rbx_disp8); Emit8(offsetof(Registers, index)); Emit16(op.nnn);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// mov rax, address; mov word [rax], value
+void Jit::EmitStore16(const void* address, word value)
+{
+    Emit8(0x48); Emit8(0xb8); Emit64(reinterpret_cast<uint64_t>(address));
+    Emit8(0x66); Emit8(0xc7); Emit8(0x00); Emit16(value);
+}
+
+// handler(cpu, record) using whichever calling convention the host has
+void Jit::EmitCall(const Instruction& op)
+{
+    records.push_back(op);
+
+#ifdef _WIN32
+    const byte first_argument = 0xb9, second_argument = 0xba;     // rcx, rdx
+#else
+    const byte first_argument = 0xbf, second_argument = 0xbe;     // rdi, rsi
+#endif
+
+    Emit8(0x48); Emit8(first_argument);  Emit64(reinterpret_cast<uint64_t>(cpu));
+    Emit8(0x48); Emit8(second_argument); Emit64(reinterpret_cast<uint64_t>(&records.back()));
+    Emit8(0x48); Emit8(0xb8);            Emit64(reinterpret_cast<uint64_t>(op.handler));
+    Emit8(0xff); Emit8(0xd0);            // call rax
+}
+
+};
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "cpu.hpp"
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <vector>
+
+// only x86-64 has a code generator, everything else keeps interpreting
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_X64 1
+#endif
+
+namespace chip8
+{
+namespace cpu
+{
+
+// translates basic blocks of chip8 code into x86-64 and caches them by pc.
+// simple register ops are emitted inline, everything else calls the same
+// handler the interpreter uses so results always match it
+class Jit
+{
+private:
+    using BlockFunction = void (*)();
+
+    // a translated run of instructions ending at the first control transfer
+    struct Block
+    {
+        BlockFunction code;
+        word        length;     // instructions in the block
+    };
+
+    static const std::size_t code_size        = 1 << 20;
+    static const std::size_t max_block_length = 64;
+    static const std::size_t max_records      = 0x4000;
+
+private:
+    CPU*    cpu = nullptr;      // the cpu blocks are translated for, see Attach
+    byte*   code = nullptr;     // read execute except while a block is emitted, nullptr if it couldn't be mapped
+    std::size_t code_used = 0;
+
+    std::array<Block, 0x1000> blocks = {};
+    std::bitset<0x1000>      covered;      // ram bytes read by some cached block
+
+    // operands for handlers called from translated code, never reallocated
+    std::vector<Instruction> records;
+
+public:
+    Jit();
+    Jit(const Jit& jit) = delete;
+    Jit(Jit&& jit) = delete;
+    ~Jit();
+
+public:
+    bool Available() const { return code != nullptr; }
+    bool AttachedTo(const CPU& cpu) const { return this->cpu == &cpu; }
+    void Attach(CPU& cpu);
+    std::size_t Run(std::size_t cycles);
+    void Invalidate(word address, word length);
+    void Flush();
+
+private:
+    const Block* Translate(word pc);
+    static bool EndsBlock(word opcode);
+    bool Protect(byte* start, std::size_t length, bool writable);
+
+private:    // x86-64 emitter
+    void Emit8(byte value);
+    void Emit16(word value);
+    void Emit64(uint64_t value);
+    void EmitPrologue();
+    void EmitEpilogue();
+    bool EmitInline(const Instruction& op);
+    void EmitStore16(const void* address, word value);
+    void EmitCall(const Instruction& op);
+};
+
+};
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include "memory.hpp"
+
+namespace chip8
+{
+namespace cpu
+{
+
+namespace
+{
+
+// the least an arena grows by, so cpus made one at a time don't each
+// allocate their own chunk
+const std::size_t min_growth = 0x40;
+
+}
+
+PageArena::PageArena(std::size_t pages)
+{
+    Reserve(pages);
+    Unreserve(pages);
+}
+
+void PageArena::Reserve(std::size_t pages)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    reserved += pages;
+    if (reserved <= capacity)
+        return;
+
+    // pages aren't touched here, a reserved page is only mapped when it's
+    // first written
+    std::size_t growth = std::max({ reserved - capacity, capacity, min_growth });
+    chunks.emplace_back(new PageBlock[growth]);
+    capacity += growth;
+
+    free_blocks.reserve(capacity);
+    for (std::size_t i = growth; i > 0; i--)
+        free_blocks.push_back(&chunks.back()[i - 1]);
+}
+
+void PageArena::Unreserve(std::size_t pages)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    reserved -= pages;
+}
+
+// never empty for a memory that reserved its pages
+PageBlock* PageArena::Take()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    PageBlock* block = free_blocks.back();
+    free_blocks.pop_back();
+    return block;
+}
+
+void PageArena::Give(PageBlock* block)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    free_blocks.push_back(block);
+}
+
+std::size_t PageArena::Capacity()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return capacity;
+}
+
+std::size_t PageArena::PagesInUse()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return capacity - free_blocks.size();
+}
+
+// never destroyed, memories in other statics can outlive it otherwise
+PageArena& PageArena::Default()
+{
+    static PageArena* arena = new PageArena();
+    return *arena;
+}
+
+Memory::Memory(PageArena* arena)
+    : arena(arena ? arena : &PageArena::Default())
+{
+    pages.fill(ZeroPage());
+    for (std::size_t page = 0; page < page_count; page++)
+        Retain(pages[page]);
+
+    this->arena->Reserve(page_count);
+    reserved = true;
+}
+
+// copies take their pages from the default arena, a pool's arena can go
+// away before a copy of one of its cpus does
+Memory::Memory(const Memory& memory)
+    : Memory()
+{
+    Assign(memory);
+}
+
+// memory is left cleared, it reserves pages again if it's written
+Memory::Memory(Memory&& memory) noexcept
+    : pages(memory.pages), owned(memory.owned), reserved(memory.reserved), arena(memory.arena)
+{
+    memory.owned = 0;
+    memory.reserved = false;
+    for (std::size_t page = 0; page < page_count; page++)
+    {
+        memory.pages[page] = ZeroPage();
+        Retain(memory.pages[page]);
+    }
+}
+
+// keeps the arena this memory already takes pages from
+Memory& Memory::operator=(const Memory& memory)
+{
+    if (this != &memory)
+        Assign(memory);
+    return *this;
+}
+
+// owned pages go back to the arena they came from, so pages only change
+// hands when both memories use the same one
+Memory& Memory::operator=(Memory&& memory) noexcept
+{
+    if (this == &memory)
+        return *this;
+
+    if (arena != memory.arena)
+    {
+        Assign(memory);
+        memory.Clear();
+        return *this;
+    }
+
+    for (std::size_t page = 0; page < page_count; page++)
+        Drop(page);
+
+    pages = memory.pages;
+    owned = memory.owned;
+    std::swap(reserved, memory.reserved);
+
+    memory.owned = 0;
+    for (std::size_t page = 0; page < page_count; page++)
+    {
+        memory.pages[page] = ZeroPage();
+        Retain(memory.pages[page]);
+    }
+    return *this;
+}
+
+Memory::~Memory()
+{
+    for (std::size_t page = 0; page < page_count; page++)
+        Drop(page);
+
+    if (reserved)
+        arena->Unreserve(page_count);
+}
+
+// copies length bytes at address from memory, sharing every shared page
+// that ends up the same as memory's instead of copying it
+void Memory::Copy(const Memory& memory, std::size_t address, std::size_t length)
+{
+    std::size_t end = address + length;
+    for (std::size_t page = address / page_size; page * page_size < end; page++)
+    {
+        std::size_t first = std::max(address, page * page_size) % page_size;
+        std::size_t last = std::min(end, (page + 1) * page_size) - page * page_size;
+
+        const uint8_t* mine = pages[page]->bytes.data();
+        const uint8_t* theirs = memory.pages[page]->bytes.data();
+        if (!memory.Owns(page) &&
+            std::memcmp(mine, theirs, first) == 0 &&
+            std::memcmp(mine + last, theirs + last, page_size - last) == 0)
+            Share(page, memory.pages[page]);
+        else
+            std::memcpy(Own(page).data() + first, theirs + first, last - first);
+    }
+}
+
+// back to all zeros, owned pages go back to the arena
+void Memory::Clear()
+{
+    for (std::size_t page = 0; page < page_count; page++)
+        Share(page, ZeroPage());
+}
+
+void Memory::Share(std::size_t page, PageBlock* block)
+{
+    if (pages[page] == block)
+        return;
+
+    Retain(block);
+    Drop(page);
+    pages[page] = block;
+}
+
+// turns every page this memory wrote into a new shared page, so its copies
+// share them instead of copying them. allocates, so it's for loading roms
+// and not for running them
+void Memory::Freeze()
+{
+    for (std::size_t page = 0; page < page_count; page++)
+    {
+        if (!Owns(page))
+            continue;
+
+        PageBlock* block = NewSharedPage(pages[page]->bytes);
+        Share(page, block);
+        Release(block);
+    }
+}
+
+std::size_t Memory::OwnedPages() const
+{
+    std::size_t count = 0;
+    for (std::size_t page = 0; page < page_count; page++)
+        count += Owns(page);
+    return count;
+}
+
+PageBlock* Memory::NewSharedPage(const Page& bytes)
+{
+    PageBlock* block = new PageBlock;
+    block->bytes = bytes;
+    block->shares = 1;
+    return block;
+}
+
+// the only time a write waits on the arena, once per page until it's shared
+// again
+void Memory::Unshare(std::size_t page)
+{
+    if (!reserved)
+    {
+        arena->Reserve(page_count);
+        reserved = true;
+    }
+
+    PageBlock* block = arena->Take();
+    block->bytes = pages[page]->bytes;
+    Release(pages[page]);
+    pages[page] = block;
+    owned |= 1 << page;
+}
+
+void Memory::Drop(std::size_t page)
+{
+    if (Owns(page))
+    {
+        arena->Give(pages[page]);
+        owned &= ~(1 << page);
+    }
+    else
+        Release(pages[page]);
+}
+
+// shared pages are shared, owned ones are copied into pages we own
+void Memory::Assign(const Memory& memory)
+{
+    for (std::size_t page = 0; page < page_count; page++)
+    {
+        if (memory.Owns(page))
+            Own(page) = memory.pages[page]->bytes;
+        else
+            Share(page, memory.pages[page]);
+    }
+}
+
+// the static share keeps it alive forever
+PageBlock* Memory::ZeroPage()
+{
+    static PageBlock* zero = NewSharedPage(Page());
+    return zero;
+}
+
+void Memory::Retain(PageBlock* block)
+{
+    block->shares.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Memory::Release(PageBlock* block)
+{
+    if (block->shares.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete block;
+}
+
+};
+};
\ No newline at end of file
@@ -0,0 +1,198 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace chip8
+{
+namespace cpu
+{
+
+// a page of ram. shared pages are read only and count the memories reading
+// them, the last one to let go deletes it. pages handed out by an arena
+// belong to one memory and don't use the count
+struct PageBlock
+{
+    static const std::size_t size = 0x100;
+
+    std::array<uint8_t, size> bytes;
+    std::atomic<uint32_t>     shares;
+};
+
+// pages memories copy shared pages into, handed out and given back without
+// touching the allocator. a memory reserves the 16 pages it could ever need
+// when it's made, so taking one can never find the arena empty. reserved
+// pages are only address space until something is written to them. one
+// arena can serve memories on many threads
+class PageArena
+{
+private:
+    std::mutex                                lock;
+    std::vector<std::unique_ptr<PageBlock[]>> chunks;
+    std::vector<PageBlock*>                   free_blocks;
+    std::size_t                               capacity = 0;
+    std::size_t                               reserved = 0;
+
+public:
+    explicit PageArena(std::size_t pages = 0);
+    PageArena(const PageArena& arena) = delete;
+    PageArena(PageArena&& arena) = delete;
+
+public:
+    // allocates when the arena has to grow, never after that
+    void Reserve(std::size_t pages);
+    void Unreserve(std::size_t pages);
+
+    PageBlock* Take();
+    void Give(PageBlock* block);
+
+    std::size_t Capacity();
+    std::size_t PagesInUse();
+
+    // for memories made outside a pool
+    static PageArena& Default();
+};
+
+// 4 KB of ram split into 16 pages of 256 bytes. every page starts shared,
+// copies share all of them, and a page is copied into one taken from the
+// arena the first time it's written. thousands of cpus running one rom read
+// a single copy of the rom and the font and only hold the pages they wrote
+class Memory
+{
+public:
+    static const std::size_t page_size = PageBlock::size;
+    static const std::size_t page_count = 0x1000 / page_size;
+    using Page = std::array<uint8_t, page_size>;
+
+private:
+    std::array<PageBlock*, page_count> pages;
+    uint16_t   owned = 0;           // bit per page taken from the arena
+    bool       reserved = false;    // the arena holds page_count pages for us
+    PageArena* arena;
+
+public:
+    // takes pages from arena, the default arena when it's nullptr
+    explicit Memory(PageArena* arena = nullptr);
+    Memory(const Memory& memory);
+    Memory(Memory&& memory) noexcept;
+    Memory& operator=(const Memory& memory);
+    Memory& operator=(Memory&& memory) noexcept;
+    ~Memory();
+
+public:
+    static constexpr std::size_t size() { return page_count * page_size; }
+
+    uint8_t Read(std::size_t address) const
+    {
+        return pages[address / page_size]->bytes[address % page_size];
+    }
+
+    void Write(std::size_t address, uint8_t value)
+    {
+        Own(address / page_size)[address % page_size] = value;
+    }
+
+    // copies data in, pages it wouldn't change are left shared. false if
+    // nothing changed
+    bool Write(std::size_t address, const uint8_t* data, std::size_t length)
+    {
+        bool changed = false;
+        while (length > 0)
+        {
+            std::size_t page = address / page_size;
+            std::size_t offset = address % page_size;
+            std::size_t count = std::min(length, page_size - offset);
+
+            if (std::memcmp(pages[page]->bytes.data() + offset, data, count) != 0)
+            {
+                std::memcpy(Own(page).data() + offset, data, count);
+                changed = true;
+            }
+
+            address += count;
+            data += count;
+            length -= count;
+        }
+        return changed;
+    }
+
+    void Read(std::size_t address, uint8_t* data, std::size_t length) const
+    {
+        while (length > 0)
+        {
+            std::size_t offset = address % page_size;
+            std::size_t count = std::min(length, page_size - offset);
+            std::memcpy(data, pages[address / page_size]->bytes.data() + offset, count);
+
+            address += count;
+            data += count;
+            length -= count;
+        }
+    }
+
+    void Copy(const Memory& memory, std::size_t address, std::size_t length);
+    void Clear();
+
+    // makes page the shared page block, which keeps its own count
+    void Share(std::size_t page, PageBlock* block);
+    void Freeze();
+
+    // pages taken from the arena, the ram this cpu needs beyond the shared pages
+    std::size_t OwnedPages() const;
+
+    // a new shared page holding bytes, its first share belongs to the caller
+    static PageBlock* NewSharedPage(const Page& bytes);
+
+    uint8_t operator[](std::size_t address) const { return Read(address); }
+
+    // for tests and tools, reading through this copies a shared page too
+    uint8_t& operator[](std::size_t address)
+    {
+        return Own(address / page_size)[address % page_size];
+    }
+
+    bool operator==(const Memory& memory) const
+    {
+        for (std::size_t page = 0; page < page_count; page++)
+        {
+            if (pages[page] != memory.pages[page] && pages[page]->bytes != memory.pages[page]->bytes)
+                return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const Memory& memory) const { return !(*this == memory); }
+
+private:
+    bool Owns(std::size_t page) const { return (owned >> page) & 1; }
+
+    // page, copied into one from the arena first if it's shared. only this
+    // memory ever sees the pages it owns
+    Page& Own(std::size_t page)
+    {
+        if (!Owns(page))
+            Unshare(page);
+        return pages[page]->bytes;
+    }
+
+    void Unshare(std::size_t page);
+    void Drop(std::size_t page);
+    void Assign(const Memory& memory);
+
+    static PageBlock* ZeroPage();
+    static void Retain(PageBlock* block);
+    static void Release(PageBlock* block);
+};
+
+};
+};
+
+#endif
\ No newline at end of file
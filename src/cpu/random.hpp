@@ -0,0 +1,73 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace chip8
+{
+namespace cpu
+{
+
+// xoshiro128**, small enough to live in every cpu and copy with it. the
+// same seed always gives the same numbers on every platform
+class Random
+{
+private:
+    std::array<uint32_t, 4> state;
+    uint64_t seed;
+
+public:
+    explicit Random(uint64_t seed = 0) { Seed(seed); }
+
+public:
+    // spreads the seed over the state with splitmix64 so no seed gives the
+    // all zero state
+    void Seed(uint64_t seed)
+    {
+        this->seed = seed;
+
+        uint64_t mix = seed;
+        for (std::size_t i = 0; i < state.size(); i += 2)
+        {
+            uint64_t z = (mix += 0x9e3779b97f4a7c15);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            z ^= z >> 31;
+
+            state[i] = uint32_t(z);
+            state[i + 1] = uint32_t(z >> 32);
+        }
+    }
+
+    uint32_t Next()
+    {
+        uint32_t result = Rotate(state[1] * 5, 7) * 9;
+        uint32_t t = state[1] << 9;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = Rotate(state[3], 11);
+
+        return result;
+    }
+
+    uint64_t GetSeed() const { return seed; }
+    const std::array<uint32_t, 4>& GetState() const { return state; }
+    void SetState(const std::array<uint32_t, 4>& state) { this->state = state; }
+
+private:
+    static uint32_t Rotate(uint32_t value, int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+};
+
+};
+};
+
+#endif
\ No newline at end of file
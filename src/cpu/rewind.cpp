@@ -0,0 +1,222 @@
+#include "rewind.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace chip8
+{
+namespace cpu
+{
+
+namespace
+{
+
+// keyframes are encoded against nothing, mostly zeroed ram packs well
+const State blank = {};
+
+// every encoded segment is a 2 byte skip, a 2 byte count and count xored bytes
+const std::size_t segment_header = 4;
+
+}
+
+RewindBuffer::RewindBuffer(std::size_t frames, std::size_t bytes, std::size_t keyframe_interval)
+    : entries(std::max<std::size_t>(frames, 1)),
+      data(std::max(bytes, sizeof(State) + segment_header)),
+      scratch(sizeof(State) + segment_header),
+      keyframe_interval(std::max<std::size_t>(keyframe_interval, 1))
+{
+}
+
+void RewindBuffer::Push(const CPU& cpu)
+{
+    cpu.SaveState(current);
+
+    if (count == entries.size())
+        DropOldest();
+
+    bool keyframe = count == 0 || since_key + 1 >= keyframe_interval;
+    std::size_t length = Encode(current, keyframe ? blank : key, scratch.data());
+    std::size_t offset = Reserve(length);
+
+    // making room dropped the keyframe this delta was against
+    if (!keyframe && count == 0)
+    {
+        keyframe = true;
+        length = Encode(current, blank, scratch.data());
+        offset = Reserve(length);
+    }
+
+    std::memcpy(&data[offset], scratch.data(), length);
+    write = offset + length;
+
+    entries[(first + count) % entries.size()] = { offset, length, keyframe };
+    count++;
+
+    if (keyframe)
+    {
+        key = current;
+        since_key = 0;
+    }
+    else
+        since_key++;
+}
+
+bool RewindBuffer::Rewind(CPU& cpu, std::size_t frames)
+{
+    if (frames >= count)
+        return false;
+
+    Decode(frames, current);
+    if (!cpu.LoadState(current))
+        return false;
+
+    count -= frames;
+    write = At(0).offset + At(0).length;
+
+    // later pushes are encoded against the newest keyframe still kept
+    since_key = 0;
+    while (!At(since_key).key)
+        since_key++;
+    Decode(since_key, key);
+    return true;
+}
+
+void RewindBuffer::Clear()
+{
+    first = 0;
+    count = 0;
+    write = 0;
+    since_key = 0;
+}
+
+std::size_t RewindBuffer::BytesUsed() const
+{
+    std::size_t used = 0;
+    for (std::size_t age = 0; age < count; age++)
+        used += At(age).length;
+    return used;
+}
+
+// age 0 is the newest entry
+const RewindBuffer::Entry& RewindBuffer::At(std::size_t age) const
+{
+    return entries[(first + count - 1 - age) % entries.size()];
+}
+
+// a delta is applied on top of the keyframe before it
+void RewindBuffer::Decode(std::size_t age, State& state) const
+{
+    std::size_t keyframe = age;
+    while (!At(keyframe).key)
+        keyframe++;
+
+    state = blank;
+    Apply(&data[At(keyframe).offset], At(keyframe).length, state);
+    if (keyframe != age)
+        Apply(&data[At(age).offset], At(age).length, state);
+}
+
+// where length bytes can be written, dropping the oldest entries until
+// they fit. entries never wrap, the end of data is skipped instead
+std::size_t RewindBuffer::Reserve(std::size_t length)
+{
+    for (;;)
+    {
+        if (count == 0)
+            return write = 0;
+        if (length == 0)
+            return write;
+
+        std::size_t oldest = entries[first].offset;
+        if (write > oldest)
+        {
+            if (length <= data.size() - write)
+                return write;
+            write = 0;
+            continue;
+        }
+
+        if (write < oldest && length <= oldest - write)
+            return write;
+
+        DropOldest();
+    }
+}
+
+// deltas are useless without their keyframe so they go with it
+void RewindBuffer::DropOldest()
+{
+    do
+    {
+        first = (first + 1) % entries.size();
+        count--;
+    } while (count > 0 && !entries[first].key);
+}
+
+// xors state against reference and keeps only the runs that differ. a run
+// only ends at 4 or more equal bytes so every header after the first is
+// paid for by the bytes it skips, the output is never more than
+// sizeof(State) + segment_header
+std::size_t RewindBuffer::Encode(const State& state, const State& reference, byte* out)
+{
+    const byte* a = reinterpret_cast<const byte*>(&state);
+    const byte* b = reinterpret_cast<const byte*>(&reference);
+    const std::size_t size = sizeof(State);
+
+    std::size_t length = 0;
+    std::size_t position = 0;
+    std::size_t i = 0;
+
+    for (;;)
+    {
+        while (i < size && a[i] == b[i])
+            i++;
+        if (i == size)
+            return length;
+
+        std::size_t start = i;
+        while (i < size)
+        {
+            if (a[i] != b[i])
+            {
+                i++;
+                continue;
+            }
+
+            std::size_t equal = i;
+            while (equal < size && a[equal] == b[equal])
+                equal++;
+            if (equal - i >= segment_header || equal == size)
+                break;
+            i = equal;
+        }
+
+        uint16_t header[2] = { uint16_t(start - position), uint16_t(i - start) };
+        std::memcpy(out + length, header, sizeof(header));
+        length += sizeof(header);
+
+        for (std::size_t j = start; j < i; j++)
+            out[length++] = a[j] ^ b[j];
+        position = i;
+    }
+}
+
+void RewindBuffer::Apply(const byte* in, std::size_t length, State& state)
+{
+    byte* out = reinterpret_cast<byte*>(&state);
+    std::size_t position = 0;
+
+    for (std::size_t i = 0; i < length;)
+    {
+        uint16_t header[2];
+        std::memcpy(header, in + i, sizeof(header));
+        i += sizeof(header);
+
+        position += header[0];
+        for (std::size_t j = 0; j < header[1]; j++)
+            out[position++] ^= in[i++];
+    }
+}
+
+};
+};
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "cpu.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chip8
+{
+namespace cpu
+{
+
+// the last frames of a cpu's history in a fixed amount of memory. every
+// keyframe_interval frames a full state is kept, the frames between hold
+// only the bytes that differ from that keyframe, xored and run length
+// encoded. when either limit is reached the oldest keyframe goes together
+// with the frames that depend on it
+class RewindBuffer
+{
+private:
+    struct Entry
+    {
+        std::size_t offset;     // into data
+        std::size_t length;
+        bool        key;
+    };
+
+private:
+    std::vector<Entry>  entries;        // ring, oldest at first
+    std::size_t         first = 0;
+    std::size_t         count = 0;
+    std::vector<byte>   data;           // ring of encoded entries
+    std::size_t         write = 0;
+    std::vector<byte>   scratch;        // the entry being encoded
+    std::size_t         keyframe_interval;
+    std::size_t         since_key = 0;  // entries pushed after the newest keyframe
+    State               key;            // the newest keyframe, decoded
+    State               current;
+
+public:
+    // frames is the most history kept, bytes the memory it's encoded into
+    RewindBuffer(std::size_t frames, std::size_t bytes, std::size_t keyframe_interval = 60);
+    RewindBuffer(const RewindBuffer& buffer) = delete;
+    RewindBuffer(RewindBuffer&& buffer) = delete;
+
+public:
+    // saves cpu as the newest frame, call once per frame
+    void Push(const CPU& cpu);
+
+    // loads the state pushed frames pushes ago, 0 being the newest, and
+    // forgets everything newer. false and nothing changed if it's gone
+    bool Rewind(CPU& cpu, std::size_t frames = 0);
+
+    void Clear();
+    std::size_t Size() const { return count; }
+    std::size_t Capacity() const { return entries.size(); }
+    std::size_t BytesUsed() const;
+
+private:
+    const Entry& At(std::size_t age) const;
+    void Decode(std::size_t age, State& state) const;
+    std::size_t Reserve(std::size_t length);
+    void DropOldest();
+    static std::size_t Encode(const State& state, const State& reference, byte* out);
+    static void Apply(const byte* in, std::size_t length, State& state);
+};
+
+};
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "environment.hpp"
+#include "../graphics/present.hpp"
+
+#include <algorithm>
+
+namespace chip8
+{
+namespace env
+{
+
+// every instance starts as a copy of one cpu so they all share its rom pages
+VectorEnv::VectorEnv(std::size_t size, const byte* rom, std::size_t rom_size, const Config& config)
+    : config(config), frames(size, 0), seeds(config.seed)
+{
+    cpu::CPU first(config.engine, config.quirks);
+    first.LoadROM(rom, rom_size);
+    first.SaveState(start);
+
+    instances.reserve(size);
+    for (std::size_t instance = 0; instance < size; instance++)
+    {
+        instances.push_back(first);
+        Restart(instance);
+    }
+}
+
+void VectorEnv::Reset(byte* observations)
+{
+    for (std::size_t instance = 0; instance < Size(); instance++)
+        Reset(instance, observations + instance * observation_size);
+}
+
+void VectorEnv::Reset(std::size_t instance, byte* observation)
+{
+    Restart(instance);
+    Observe(instance, observation);
+}
+
+void VectorEnv::Step(const uint16_t* keys, byte* observations, float* rewards, byte* dones)
+{
+    for (std::size_t instance = 0; instance < Size(); instance++)
+    {
+        cpu::CPU& cpu = instances[instance];
+        float reward = 0;
+        bool done = false;
+
+        for (byte key = 0; key < 16; key++)
+            cpu.SetKey(key, (keys[instance] >> key) & 1);
+
+        for (std::size_t frame = 0; frame < config.frame_skip && !done; frame++)
+        {
+            cpu.RunFrame(config.instructions_per_frame);
+            frames[instance]++;
+
+            if (config.reward != nullptr)
+                reward += config.reward(config.user, instance, cpu);
+            if (config.done != nullptr)
+                done = config.done(config.user, instance, cpu);
+            if (config.max_frames != 0 && frames[instance] >= config.max_frames)
+                done = true;
+        }
+
+        if (done)
+            Restart(instance);
+
+        rewards[instance] = reward;
+        dones[instance] = done;
+        Observe(instance, observations + instance * observation_size);
+    }
+}
+
+// back to the state saved after loading the rom with a fresh seed. only
+// the ram pages the episode changed are written back and only code on them
+// is decoded again, the quirks and rom are the same so nothing else is
+void VectorEnv::Restart(std::size_t instance)
+{
+    cpu::CPU& cpu = instances[instance];
+    cpu.LoadState(start);
+
+    uint64_t seed = seeds.Next();
+    cpu.Seed((seed << 32) | seeds.Next());
+    frames[instance] = 0;
+}
+
+// unpacks the screen's rows into one byte per pixel
+void VectorEnv::Observe(std::size_t instance, byte* observation) const
+{
+    graphics::Palette pixels;
+    pixels.off_index = 0;
+    pixels.on_index = 1;
+    graphics::Expand(instances[instance].GetVRAM(), graphics::PixelFormat::Indexed8, pixels, 1,
+                     observation, cpu::screen_width);
+}
+
+};
+};
\ No newline at end of file
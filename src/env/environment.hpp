@@ -0,0 +1,78 @@
+#ifndef ENVIRONMENT_H
+#define ENVIRONMENT_H
+
+#include "../cpu/cpu.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chip8
+{
+namespace env
+{
+
+using cpu::byte;
+
+// reward for one frame of one instance, usually read from the rom's score
+// in ram. instance lets the hook keep its own per instance state
+using RewardHook = float (*)(void* user, std::size_t instance, const cpu::CPU& cpu);
+
+// true when the instance's episode is over, checked after every frame
+using DoneHook = bool (*)(void* user, std::size_t instance, const cpu::CPU& cpu);
+
+struct Config
+{
+    cpu::Engine engine = cpu::Engine::Predecoded;
+    cpu::Quirks quirks;
+    std::size_t frame_skip = 4;                 // frames run per step with the same keys
+    std::size_t instructions_per_frame = 10;
+    std::size_t max_frames = 0;                 // episodes are cut off after this many, 0 for never
+    uint64_t    seed = 0;                       // every episode draws its own cpu seed from this
+    RewardHook  reward = nullptr;
+    DoneHook    done = nullptr;
+    void*       user = nullptr;
+};
+
+// many copies of one rom stepped together for training agents. each step
+// takes one key mask per instance, bit k holding key k, and fills caller
+// owned arrays so stepping never allocates. instances whose episode ended
+// are reset from a saved state on the spot and report the observation of
+// their new episode
+class VectorEnv
+{
+public:
+    // one byte per pixel, 0 or 1, rows top to bottom
+    static const std::size_t observation_size = cpu::screen_width * cpu::screen_height;
+
+private:
+    Config                 config;
+    std::vector<cpu::CPU>  instances;
+    std::vector<std::size_t> frames;    // frames into each instance's episode
+    cpu::State             start;
+    cpu::Random            seeds;
+
+public:
+    VectorEnv(std::size_t size, const byte* rom, std::size_t rom_size, const Config& config = Config());
+
+public:
+    // starts every episode again, observations holds Size() observations
+    void Reset(byte* observations);
+    void Reset(std::size_t instance, byte* observation);
+
+    // keys, rewards and dones hold Size() entries. rewards are summed over
+    // the skipped frames, dones are 1 where an episode ended
+    void Step(const uint16_t* keys, byte* observations, float* rewards, byte* dones);
+
+    std::size_t Size() const { return instances.size(); }
+    const cpu::CPU& Instance(std::size_t instance) const { return instances[instance]; }
+
+private:
+    void Restart(std::size_t instance);
+    void Observe(std::size_t instance, byte* observation) const;
+};
+
+};
+};
+
+#endif
\ No newline at end of file
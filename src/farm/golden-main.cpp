@@ -0,0 +1,102 @@
+#include "golden.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using chip8::cpu::Engine;
+
+// usage: chip8-golden [-j threads] [-e engine|all] [-u] manifest
+// runs every trace in the manifest and compares the screen hashes at its
+// checkpoints with the golden ones, -u records the switch interpreter's
+// hashes as the new goldens instead
+int main(int argc, char** argv)
+{
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string engine_name = "all";
+    bool update = false;
+
+    int arg = 1;
+    for (; arg < argc - 1 && argv[arg][0] == '-'; arg++)
+    {
+        if (std::strcmp(argv[arg], "-u") == 0)
+            update = true;
+        else if (std::strcmp(argv[arg], "-j") == 0 && arg + 2 < argc)
+            threads = std::max(1l, std::atol(argv[++arg]));
+        else if (std::strcmp(argv[arg], "-e") == 0 && arg + 2 < argc)
+            engine_name = argv[++arg];
+        else
+            break;
+    }
+
+    Engine named;
+    if (arg != argc - 1 || (engine_name != "all" && !chip8::cpu::ParseEngine(engine_name.c_str(), named)))
+    {
+        std::printf("usage: %s [-j threads] [-e engine|all] [-u] manifest\n", argv[0]);
+        return 1;
+    }
+
+    std::string manifest = argv[arg];
+    std::vector<chip8::farm::Trace> traces;
+    std::string error;
+    if (!chip8::farm::LoadManifest(manifest, traces, error))
+    {
+        std::printf("%s\n", error.c_str());
+        return 1;
+    }
+
+    if (update)
+    {
+        auto results = chip8::farm::RunTraces(traces, Engine::Interpreter, threads);
+        for (std::size_t i = 0; i < traces.size(); i++)
+        {
+            for (std::size_t j = 0; j < traces[i].checkpoints.size() && j < results[i].hashes.size(); j++)
+                traces[i].checkpoints[j].hash = results[i].hashes[j];
+        }
+
+        if (!chip8::farm::SaveManifest(manifest, traces))
+        {
+            std::printf("couldn't write %s\n", manifest.c_str());
+            return 1;
+        }
+
+        std::printf("updated %zu traces\n", traces.size());
+        return 0;
+    }
+
+    int failures = 0;
+    int runs = 0;
+    for (std::size_t e = 0; e < chip8::cpu::engine_count; e++)
+    {
+        Engine engine = Engine(e);
+        const char* name = chip8::cpu::EngineName(engine);
+        if (engine_name != "all" && engine_name != name)
+            continue;
+
+        auto results = chip8::farm::RunTraces(traces, engine, threads);
+        for (std::size_t i = 0; i < traces.size(); i++)
+        {
+            runs++;
+            if (chip8::farm::Matches(traces[i], results[i]))
+                continue;
+
+            failures++;
+            std::printf("FAIL %-10s %s%s\n", name, traces[i].rom.c_str(), results[i].loaded ? "" : " (not loaded)");
+
+            for (std::size_t j = 0; j < traces[i].checkpoints.size() && j < results[i].hashes.size(); j++)
+            {
+                if (traces[i].checkpoints[j].hash != results[i].hashes[j])
+                {
+                    std::printf("     frame %zu expected %016llx got %016llx\n", traces[i].checkpoints[j].frame,
+                                (unsigned long long)traces[i].checkpoints[j].hash, (unsigned long long)results[i].hashes[j]);
+                }
+            }
+        }
+    }
+
+    std::printf("%d of %d runs match\n", runs - failures, runs);
+    return failures == 0 ? 0 : 2;
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "golden.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace chip8
+{
+namespace farm
+{
+
+bool LoadManifest(const std::string& path, std::vector<Trace>& traces, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        error = "couldn't open " + path;
+        return false;
+    }
+
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++)
+    {
+        std::istringstream words(line.substr(0, line.find('#')));
+        std::string directive;
+        if (!(words >> directive))
+            continue;
+
+        if (directive == "rom")
+        {
+            traces.emplace_back();
+            words >> traces.back().rom;
+            continue;
+        }
+
+        if (traces.empty())
+        {
+            error = path + ":" + std::to_string(number) + ": " + directive + " before any rom";
+            return false;
+        }
+
+        Trace& trace = traces.back();
+        bool ok = true;
+
+        if (directive == "frames")
+            ok = bool(words >> trace.frames);
+        else if (directive == "ipf")
+            ok = bool(words >> trace.instructions_per_frame);
+        else if (directive == "seed")
+            ok = bool(words >> trace.seed);
+        else if (directive == "quirks")
+        {
+            trace.quirks = cpu::Quirks();
+            for (std::string quirk; words >> quirk;)
+            {
+                if (quirk == "super_chip")
+                    trace.quirks.super_chip = true;
+                else if (quirk == "old_store_load")
+                    trace.quirks.new_store_load = false;
+                else
+                    ok = false;
+            }
+        }
+        else if (directive == "press" || directive == "release")
+        {
+            KeyEvent event;
+            unsigned key;
+            ok = bool(words >> event.frame >> key) && key < 16;
+            event.key = byte(key);
+            event.down = directive == "press";
+            trace.keys.push_back(event);
+        }
+        else if (directive == "check")
+        {
+            Checkpoint checkpoint;
+            ok = bool(words >> checkpoint.frame >> std::hex >> checkpoint.hash);
+            trace.checkpoints.push_back(checkpoint);
+        }
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            error = path + ":" + std::to_string(number) + ": can't read '" + line + "'";
+            return false;
+        }
+    }
+
+    // runs rely on events and checkpoints being in frame order
+    for (auto& trace : traces)
+    {
+        std::stable_sort(trace.keys.begin(), trace.keys.end(),
+                         [](const KeyEvent& a, const KeyEvent& b) { return a.frame < b.frame; });
+        std::stable_sort(trace.checkpoints.begin(), trace.checkpoints.end(),
+                         [](const Checkpoint& a, const Checkpoint& b) { return a.frame < b.frame; });
+    }
+
+    return true;
+}
+
+bool SaveManifest(const std::string& path, const std::vector<Trace>& traces)
+{
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    for (const auto& trace : traces)
+    {
+        std::fprintf(file, "rom %s\n", trace.rom.c_str());
+        std::fprintf(file, "frames %zu\n", trace.frames);
+        std::fprintf(file, "ipf %zu\n", trace.instructions_per_frame);
+        std::fprintf(file, "seed %llu\n", (unsigned long long)trace.seed);
+
+        if (trace.quirks.super_chip || !trace.quirks.new_store_load)
+        {
+            std::fprintf(file, "quirks%s%s\n", trace.quirks.super_chip ? " super_chip" : "",
+                         trace.quirks.new_store_load ? "" : " old_store_load");
+        }
+
+        for (const auto& event : trace.keys)
+            std::fprintf(file, "%s %zu %d\n", event.down ? "press" : "release", event.frame, event.key);
+        for (const auto& checkpoint : trace.checkpoints)
+            std::fprintf(file, "check %zu %016llx\n", checkpoint.frame, (unsigned long long)checkpoint.hash);
+
+        std::fprintf(file, "\n");
+    }
+
+    return std::fclose(file) == 0;
+}
+
+TraceResult RunTrace(const Trace& trace, cpu::Engine engine)
+{
+    TraceResult result;
+
+    cpu::CPU cpu(engine, trace.quirks);
+    cpu.Seed(trace.seed);
+    result.loaded = cpu.LoadROM(trace.rom);
+    if (!result.loaded)
+        return result;
+
+    std::size_t key = 0;
+    std::size_t checkpoint = 0;
+    std::size_t last = trace.checkpoints.empty() ? 0 : trace.checkpoints.back().frame;
+
+    // checkpoint 0 is the screen before anything runs
+    for (std::size_t frame = 0; frame <= std::max(trace.frames, last); frame++)
+    {
+        for (; checkpoint < trace.checkpoints.size() && trace.checkpoints[checkpoint].frame == frame; checkpoint++)
+            result.hashes.push_back(cpu.GetVRAMHash());
+
+        if (frame == std::max(trace.frames, last))
+            break;
+
+        for (; key < trace.keys.size() && trace.keys[key].frame == frame; key++)
+            cpu.SetKey(trace.keys[key].key, trace.keys[key].down);
+
+        cpu.RunFrame(trace.instructions_per_frame);
+    }
+
+    return result;
+}
+
+// traces are picked up one at a time from a shared counter so slow roms
+// don't hold a whole share of the list back
+std::vector<TraceResult> RunTraces(const std::vector<Trace>& traces, cpu::Engine engine, std::size_t threads)
+{
+    std::vector<TraceResult> results(traces.size());
+    std::atomic<std::size_t> next = { 0 };
+
+    std::vector<std::thread> workers;
+    for (std::size_t worker = 0; worker < std::max<std::size_t>(threads, 1); worker++)
+    {
+        workers.emplace_back([&]()
+        {
+            for (std::size_t i = next++; i < traces.size(); i = next++)
+                results[i] = RunTrace(traces[i], engine);
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+
+    return results;
+}
+
+bool Matches(const Trace& trace, const TraceResult& result)
+{
+    if (!result.loaded || result.hashes.size() != trace.checkpoints.size())
+        return false;
+
+    for (std::size_t i = 0; i < trace.checkpoints.size(); i++)
+    {
+        if (trace.checkpoints[i].hash != result.hashes[i])
+            return false;
+    }
+    return true;
+}
+
+};
+};
\ No newline at end of file
@@ -0,0 +1,77 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include "../cpu/cpu.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace chip8
+{
+namespace farm
+{
+
+using cpu::byte;
+
+// a key going down or up before frame runs
+struct KeyEvent
+{
+    std::size_t frame;
+    byte          key;
+    bool         down;
+};
+
+// the screen hash expected once frame frames have run
+struct Checkpoint
+{
+    std::size_t frame;
+    uint64_t     hash;
+};
+
+// one rom run headless with scripted keys, checked at its checkpoints
+struct Trace
+{
+    std::string rom;
+    std::size_t frames = 0;
+    std::size_t instructions_per_frame = 10;
+    uint64_t    seed = 0;
+    cpu::Quirks quirks;
+    std::vector<KeyEvent>   keys;
+    std::vector<Checkpoint> checkpoints;
+};
+
+// the hashes a run produced, one per checkpoint in the same order
+struct TraceResult
+{
+    bool loaded = false;
+    std::vector<uint64_t> hashes;
+};
+
+// manifests are text, one directive per line and # starts a comment:
+//
+//   rom roms/pong.ch8          starts a new trace
+//   frames 600
+//   ipf 10                     instructions per frame
+//   seed 0
+//   quirks super_chip old_store_load
+//   press 30 5                 key 5 goes down before frame 30 runs
+//   release 40 5
+//   check 100 9b1c...          screen hash after 100 frames
+//
+// everything after a rom line until the next one belongs to that trace.
+// returns false and sets error on the first line it can't read
+bool LoadManifest(const std::string& path, std::vector<Trace>& traces, std::string& error);
+bool SaveManifest(const std::string& path, const std::vector<Trace>& traces);
+
+TraceResult RunTrace(const Trace& trace, cpu::Engine engine);
+std::vector<TraceResult> RunTraces(const std::vector<Trace>& traces, cpu::Engine engine, std::size_t threads);
+
+// true if every checkpoint of trace matches result
+bool Matches(const Trace& trace, const TraceResult& result);
+
+};
+};
+
+#endif
\ No newline at end of file
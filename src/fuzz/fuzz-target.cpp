@@ -0,0 +1,178 @@
+#include "../cpu/cpu.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+using chip8::cpu::byte;
+using chip8::cpu::CPU;
+using chip8::cpu::Engine;
+using chip8::cpu::Fault;
+using chip8::cpu::Idle;
+using chip8::cpu::word;
+
+// enough for most roms to leave their setup code, short enough to stay fast
+const std::size_t max_cycles = 2000;
+
+// one counter per pc and per handler, libfuzzer picks up the extra counters
+// section as coverage so inputs reaching new code or opcodes are kept
+struct Coverage
+{
+    std::array<uint8_t, 0x1000> pc;
+    std::array<uint8_t, CPU::opcode_class_count> opcode;
+};
+
+#ifdef CHIP8_LIBFUZZER
+__attribute__((used, section("__libfuzzer_extra_counters")))
+#endif
+Coverage coverage;
+
+// every worker keeps its own cpu and resets it between inputs
+CPU& WorkerCPU()
+{
+    thread_local CPU cpu(Engine::Interpreter);
+    return cpu;
+}
+
+// runs data as a rom until it has used its cycles, can't make progress or
+// faults. most random roms run off into zeroed ram and fault on the first 0000
+void Execute(const uint8_t* data, std::size_t size)
+{
+    CPU& cpu = WorkerCPU();
+    cpu.Reset();
+    cpu.LoadROM(data, size);
+
+    for (std::size_t cycle = 0; cycle < max_cycles && cpu.GetIdle() == Idle::None && cpu.GetLastFault() == Fault::None; cycle++)
+    {
+        coverage.pc[cpu.GetRegisters().pc & chip8::cpu::address_mask]++;
+        cpu.Cycle();
+        coverage.opcode[CPU::GetOpcodeClass(cpu.GetOpcode())]++;
+    }
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size)
+{
+    Execute(data, size);
+    return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+
+namespace
+{
+
+struct Totals
+{
+    std::array<uint8_t, 0x1000> pc = {};
+    std::array<uint8_t, CPU::opcode_class_count> opcode = {};
+    uint64_t faults = 0;
+};
+
+// folds this run's counters into totals and clears them for the next one
+void Collect(Totals& totals)
+{
+    for (std::size_t i = 0; i < coverage.pc.size(); i++)
+        totals.pc[i] |= coverage.pc[i];
+    for (std::size_t i = 0; i < coverage.opcode.size(); i++)
+        totals.opcode[i] |= coverage.opcode[i];
+
+    for (std::size_t fault = 1; fault < std::size_t(Fault::Count); fault++)
+        totals.faults += WorkerCPU().GetFaultCount(Fault(fault));
+
+    coverage.pc.fill(0);
+    coverage.opcode.fill(0);
+}
+
+std::vector<uint8_t> ReadFile(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+}
+
+// usage: chip8-fuzz [-n runs] [-s seed] [input...]
+// replays every input, then runs random roms and mutations of the inputs
+// and reports how much of ram and which handlers were reached. built
+// without libfuzzer so crashes found by it can be replayed anywhere
+int main(int argc, char** argv)
+{
+    long runs = 100000;
+    unsigned seed = 1;
+
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        if (argv[arg][1] == 'n')
+            runs = std::atol(argv[arg + 1]);
+        else if (argv[arg][1] == 's')
+            seed = std::strtoul(argv[arg + 1], nullptr, 0);
+    }
+
+    Totals totals;
+    std::vector<std::vector<uint8_t>> inputs;
+    for (; arg < argc; arg++)
+    {
+        inputs.push_back(ReadFile(argv[arg]));
+        Execute(inputs.back().data(), inputs.back().size());
+        Collect(totals);
+    }
+
+    std::mt19937 generator(seed);
+    std::vector<uint8_t> rom;
+    rom.reserve(0x1000);
+
+    auto start = std::chrono::steady_clock::now();
+    for (long run = 0; run < runs; run++)
+    {
+        // flip a few bytes of an input, or make up a rom when there are none
+        if (!inputs.empty())
+        {
+            rom = inputs[generator() % inputs.size()];
+            for (int flips = generator() % 8; flips >= 0 && !rom.empty(); flips--)
+                rom[generator() % rom.size()] = byte(generator());
+        }
+        else
+        {
+            rom.resize(generator() % 0x200);
+            for (auto& value : rom)
+                value = byte(generator());
+        }
+
+        Execute(rom.data(), rom.size());
+        Collect(totals);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+
+    std::size_t pcs = 0, opcodes = 0;
+    for (auto hit : totals.pc)
+        pcs += hit != 0;
+    for (auto hit : totals.opcode)
+        opcodes += hit != 0;
+
+    std::printf("runs          %ld (%.0f/s)\n", runs, seconds > 0 ? runs / seconds : 0.0);
+    std::printf("pc coverage   %zu / %zu\n", pcs, totals.pc.size());
+    std::printf("opcodes       %zu / %zu\n", opcodes, totals.opcode.size());
+    std::printf("faults        %llu\n", (unsigned long long)totals.faults);
+
+    for (std::size_t i = 0; i < totals.opcode.size(); i++)
+    {
+        if (!totals.opcode[i])
+            std::printf("  never ran   %s\n", CPU::GetOpcodeClassName(byte(i)));
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "headless.hpp"
+
+#include <algorithm>
+
+namespace chip8
+{
+namespace graphics
+{
+
+namespace
+{
+
+byte Gray(Color color)
+{
+    return byte((color.r * 77 + color.g * 150 + color.b * 29) >> 8);
+}
+
+}
+
+ImageSequence::ImageSequence(const std::string& prefix, ImageFormat format, std::size_t scale, const Palette& palette)
+    : prefix(prefix), format(format), palette(palette), scale(std::max<std::size_t>(scale, 1)),
+      path(prefix.size() + 32)
+{
+    // gray images use the palette's colors as their two levels
+    this->palette.off_index = Gray(palette.off);
+    this->palette.on_index = Gray(palette.on);
+
+    if (format == ImageFormat::PBM)
+        this->scale = 1;
+    pixels.resize(format == ImageFormat::PBM ? sizeof(cpu::Framebuffer) : Width() * Height() * 4);
+}
+
+std::size_t ImageSequence::Width() const
+{
+    return cpu::screen_width * scale;
+}
+
+std::size_t ImageSequence::Height() const
+{
+    return cpu::screen_height * scale;
+}
+
+bool ImageSequence::Present(const Frame& frame)
+{
+    const char* extensions[] = { "pbm", "pgm", "ppm" };
+    std::snprintf(path.data(), path.size(), "%s%06llu.%s", prefix.c_str(),
+                  (unsigned long long)frame.number, extensions[int(format)]);
+
+    std::FILE* file = std::fopen(path.data(), "wb");
+    if (file == nullptr)
+        return false;
+
+    std::size_t size = 0;
+    switch (format)
+    {
+        // pbm rows are big endian bits with 1 for black, so each row is
+        // flipped and byte swapped into place
+        case ImageFormat::PBM:
+            std::fprintf(file, "P4\n%zu %zu\n", Width(), Height());
+            for (std::size_t y = 0; y < cpu::screen_height; y++)
+            {
+                for (std::size_t i = 0; i < 8; i++)
+                    pixels[size++] = byte(~frame.vram[y] >> (56 - 8 * i));
+            }
+            break;
+
+        case ImageFormat::PGM:
+            std::fprintf(file, "P5\n%zu %zu\n255\n", Width(), Height());
+            Expand(frame.vram, PixelFormat::Indexed8, palette, scale, pixels.data(), Width());
+            size = Width() * Height();
+            break;
+
+        // expanded as rgba and squeezed down to rgb in place
+        case ImageFormat::PPM:
+            std::fprintf(file, "P6\n%zu %zu\n255\n", Width(), Height());
+            Expand(frame.vram, PixelFormat::RGBA32, palette, scale, pixels.data(), Width() * 4);
+            for (std::size_t pixel = 0; pixel < Width() * Height(); pixel++, size += 3)
+            {
+                pixels[size] = pixels[pixel * 4];
+                pixels[size + 1] = pixels[pixel * 4 + 1];
+                pixels[size + 2] = pixels[pixel * 4 + 2];
+            }
+            break;
+    }
+
+    bool written = std::fwrite(pixels.data(), 1, size, file) == size;
+    return std::fclose(file) == 0 && written;
+}
+
+RawStream::RawStream(std::FILE* out)
+    : out(out), packed(true)
+{
+}
+
+RawStream::RawStream(std::FILE* out, PixelFormat format, std::size_t scale, const Palette& palette)
+    : out(out), packed(false), format(format), palette(palette), scale(std::max<std::size_t>(scale, 1)),
+      pixels(cpu::screen_width * cpu::screen_height * this->scale * this->scale * BytesPerPixel(format))
+{
+}
+
+bool RawStream::Present(const Frame& frame)
+{
+    if (packed)
+        return std::fwrite(frame.vram.data(), sizeof(frame.vram), 1, out) == 1;
+
+    Expand(frame.vram, format, palette, scale, pixels.data(), cpu::screen_width * scale * BytesPerPixel(format));
+    return std::fwrite(pixels.data(), 1, pixels.size(), out) == pixels.size();
+}
+
+CallbackBackend::CallbackBackend(FrameCallback callback, void* user)
+    : callback(callback), user(user)
+{
+}
+
+};
+};
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "present.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace chip8
+{
+namespace graphics
+{
+
+// somewhere finished frames go. Present is called once per frame on the
+// thread that owns the backend, false if the frame couldn't be written
+class Backend
+{
+public:
+    virtual ~Backend() = default;
+    virtual bool Present(const Frame& frame) = 0;
+};
+
+enum class ImageFormat
+{
+    PBM,    // 1 bit per pixel, written from the packed rows and never scaled
+    PGM,    // 8 bit gray from the palette indices
+    PPM     // 24 bit color from the palette colors
+};
+
+// one image file per frame, named prefix followed by the frame number
+class ImageSequence : public Backend
+{
+private:
+    std::string       prefix;
+    ImageFormat       format;
+    Palette           palette;
+    std::size_t       scale;
+    std::vector<char> path;
+    std::vector<byte> pixels;       // one expanded frame, reused every frame
+
+public:
+    ImageSequence(const std::string& prefix, ImageFormat format, std::size_t scale = 1, const Palette& palette = Palette());
+
+public:
+    bool Present(const Frame& frame) override;
+
+private:
+    std::size_t Width() const;
+    std::size_t Height() const;
+};
+
+// every frame back to back on a stream, stdout by default. packed frames
+// are the 32 vram rows as they are in memory, 8 bytes each in host order,
+// and are written without copying. expanded frames are whatever Expand
+// makes of them with no padding, ready for a raw video reader
+class RawStream : public Backend
+{
+private:
+    std::FILE*        out;
+    bool              packed;
+    PixelFormat       format = PixelFormat::Indexed8;
+    Palette           palette;
+    std::size_t       scale = 1;
+    std::vector<byte> pixels;
+
+public:
+    explicit RawStream(std::FILE* out = stdout);
+    RawStream(std::FILE* out, PixelFormat format, std::size_t scale = 1, const Palette& palette = Palette());
+
+public:
+    bool Present(const Frame& frame) override;
+};
+
+// hands every frame to a function, the frame is only valid during the call
+using FrameCallback = bool (*)(void* user, const Frame& frame);
+
+class CallbackBackend : public Backend
+{
+private:
+    FrameCallback callback;
+    void*         user;
+
+public:
+    CallbackBackend(FrameCallback callback, void* user);
+
+public:
+    bool Present(const Frame& frame) override { return callback(user, frame); }
+};
+
+};
+};
+
+#endif
\ No newline at end of file
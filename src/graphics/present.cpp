@@ -0,0 +1,242 @@
+#include "present.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace chip8
+{
+namespace graphics
+{
+
+namespace
+{
+
+const std::size_t width = cpu::screen_width;
+
+#ifdef __AVX2__
+
+// 0xff in byte i for every set pixel i of the 32 starting at 32 * half
+__m256i Mask(uint64_t row, std::size_t half)
+{
+    uint32_t bits = uint32_t(row >> (32 - 32 * half));
+
+    // pixels run from the top bit down, so the first 8 come from byte 3
+    const __m256i spread = _mm256_setr_epi8(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+                                            1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i select = _mm256_set1_epi64x(0x0102040810204080);
+
+    __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(int(bits)), spread);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(bytes, select), select);
+}
+
+__m256i Blend(__m256i mask, __m256i off, __m256i on)
+{
+    return _mm256_xor_si256(off, _mm256_and_si256(mask, _mm256_xor_si256(off, on)));
+}
+
+void Store(byte* line, __m256i mask, byte off, byte on)
+{
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(line),
+                        Blend(mask, _mm256_set1_epi8(char(off)), _mm256_set1_epi8(char(on))));
+}
+
+void Store(uint16_t* line, __m256i mask, uint16_t off, uint16_t on)
+{
+    const __m256i off_pixels = _mm256_set1_epi16(short(off));
+    const __m256i on_pixels = _mm256_set1_epi16(short(on));
+
+    for (int quarter = 0; quarter < 2; quarter++)
+    {
+        __m128i bytes = quarter == 0 ? _mm256_castsi256_si128(mask) : _mm256_extracti128_si256(mask, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(line + 16 * quarter),
+                            Blend(_mm256_cvtepi8_epi16(bytes), off_pixels, on_pixels));
+    }
+}
+
+void Store(uint32_t* line, __m256i mask, uint32_t off, uint32_t on)
+{
+    const __m256i off_pixels = _mm256_set1_epi32(int(off));
+    const __m256i on_pixels = _mm256_set1_epi32(int(on));
+
+    for (int quarter = 0; quarter < 4; quarter++)
+    {
+        __m128i bytes = quarter < 2 ? _mm256_castsi256_si128(mask) : _mm256_extracti128_si256(mask, 1);
+        if (quarter % 2)
+            bytes = _mm_srli_si128(bytes, 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(line + 8 * quarter),
+                            Blend(_mm256_cvtepi8_epi32(bytes), off_pixels, on_pixels));
+    }
+}
+
+template <typename Pixel>
+void ExpandRow(uint64_t row, Pixel off, Pixel on, Pixel* line)
+{
+    Store(line, Mask(row, 0), off, on);
+    Store(line + 32, Mask(row, 1), off, on);
+}
+
+#elif defined(__SSE2__)
+
+// the byte of row holding pixels 8 * group to 8 * group + 7
+byte Group(uint64_t row, std::size_t group)
+{
+    return byte(row >> (width - 8 - 8 * group));
+}
+
+// 0xff in byte i for every set pixel i of the 16 starting at 16 * quarter
+__m128i Mask(uint64_t row, std::size_t quarter)
+{
+    int bits = Group(row, 2 * quarter) | (Group(row, 2 * quarter + 1) << 8);
+    const __m128i select = _mm_set1_epi64x(0x0102040810204080);
+
+    // copy each byte across the 8 lanes of its pixels
+    __m128i bytes = _mm_cvtsi32_si128(bits);
+    bytes = _mm_unpacklo_epi8(bytes, bytes);
+    bytes = _mm_unpacklo_epi16(bytes, bytes);
+    bytes = _mm_unpacklo_epi32(bytes, bytes);
+    return _mm_cmpeq_epi8(_mm_and_si128(bytes, select), select);
+}
+
+__m128i Blend(__m128i mask, __m128i off, __m128i on)
+{
+    return _mm_xor_si128(off, _mm_and_si128(mask, _mm_xor_si128(off, on)));
+}
+
+void Store(byte* line, __m128i mask, byte off, byte on)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(line),
+                     Blend(mask, _mm_set1_epi8(char(off)), _mm_set1_epi8(char(on))));
+}
+
+void Store(uint16_t* line, __m128i mask, uint16_t off, uint16_t on)
+{
+    const __m128i off_pixels = _mm_set1_epi16(short(off));
+    const __m128i on_pixels = _mm_set1_epi16(short(on));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(line), Blend(_mm_unpacklo_epi8(mask, mask), off_pixels, on_pixels));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(line + 8), Blend(_mm_unpackhi_epi8(mask, mask), off_pixels, on_pixels));
+}
+
+void Store(uint32_t* line, __m128i mask, uint32_t off, uint32_t on)
+{
+    const __m128i off_pixels = _mm_set1_epi32(int(off));
+    const __m128i on_pixels = _mm_set1_epi32(int(on));
+
+    __m128i halves[2] = { _mm_unpacklo_epi8(mask, mask), _mm_unpackhi_epi8(mask, mask) };
+    for (int half = 0; half < 2; half++)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line + 8 * half),
+                         Blend(_mm_unpacklo_epi16(halves[half], halves[half]), off_pixels, on_pixels));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(line + 8 * half + 4),
+                         Blend(_mm_unpackhi_epi16(halves[half], halves[half]), off_pixels, on_pixels));
+    }
+}
+
+template <typename Pixel>
+void ExpandRow(uint64_t row, Pixel off, Pixel on, Pixel* line)
+{
+    for (std::size_t quarter = 0; quarter < 4; quarter++)
+        Store(line + 16 * quarter, Mask(row, quarter), off, on);
+}
+
+#else
+
+template <typename Pixel>
+void ExpandRow(uint64_t row, Pixel off, Pixel on, Pixel* line)
+{
+    for (std::size_t x = 0; x < width; x++)
+        line[x] = (row >> (width - 1 - x)) & 1 ? on : off;
+}
+
+#endif
+
+template <typename Pixel>
+void ExpandWith(const cpu::Framebuffer& vram, Pixel off, Pixel on, std::size_t scale, byte* out, std::size_t stride, uint32_t rows)
+{
+    Pixel line[width];
+
+    for (std::size_t y = 0; y < vram.size(); y++, out += scale * stride)
+    {
+        if (!((rows >> y) & 1))
+            continue;
+
+        uint64_t row = vram[y];
+        Pixel* first = reinterpret_cast<Pixel*>(out);
+
+        if (scale == 1)
+            ExpandRow(row, off, on, first);
+        else
+        {
+            ExpandRow(row, off, on, line);
+            for (std::size_t x = 0; x < width; x++)
+                std::fill_n(first + x * scale, scale, line[x]);
+        }
+
+        // the other rows of a scaled pixel are copies of the first
+        for (std::size_t copy = 1; copy < scale; copy++)
+            std::memcpy(out + copy * stride, first, width * scale * sizeof(Pixel));
+    }
+}
+
+uint32_t ToRGBA32(Color color)
+{
+    const byte bytes[4] = { color.r, color.g, color.b, color.a };
+    uint32_t pixel;
+    std::memcpy(&pixel, bytes, sizeof(pixel));
+    return pixel;
+}
+
+uint16_t ToRGB565(Color color)
+{
+    return uint16_t(((color.r >> 3) << 11) | ((color.g >> 2) << 5) | (color.b >> 3));
+}
+
+}
+
+void Capture(const cpu::CPU& cpu, uint64_t number, Frame& frame)
+{
+    frame.vram = cpu.GetVRAM();
+    frame.dirty_rows = cpu.GetDirtyRows();
+    frame.number = number;
+}
+
+std::size_t BytesPerPixel(PixelFormat format)
+{
+    switch (format)
+    {
+        case PixelFormat::RGBA32:   return 4;
+        case PixelFormat::RGB565:   return 2;
+        default:                    return 1;
+    }
+}
+
+void Expand(const cpu::Framebuffer& vram, PixelFormat format, const Palette& palette,
+            std::size_t scale, void* out, std::size_t stride, uint32_t rows)
+{
+    byte* bytes = static_cast<byte*>(out);
+    scale = std::max<std::size_t>(scale, 1);
+
+    switch (format)
+    {
+        case PixelFormat::RGBA32:
+            ExpandWith(vram, ToRGBA32(palette.off), ToRGBA32(palette.on), scale, bytes, stride, rows);
+            return;
+
+        case PixelFormat::RGB565:
+            ExpandWith(vram, ToRGB565(palette.off), ToRGB565(palette.on), scale, bytes, stride, rows);
+            return;
+
+        case PixelFormat::Indexed8:
+            ExpandWith(vram, palette.off_index, palette.on_index, scale, bytes, stride, rows);
+            return;
+    }
+}
+
+};
+};
\ No newline at end of file
@@ -0,0 +1,65 @@
+#ifndef PRESENT_H
+#define PRESENT_H
+
+#include "../cpu/cpu.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace chip8
+{
+namespace graphics
+{
+
+using cpu::byte;
+
+struct Color
+{
+    byte r;
+    byte g;
+    byte b;
+    byte a;
+};
+
+enum class PixelFormat
+{
+    RGBA32,     // r, g, b, a bytes in that order
+    RGB565,     // 16 bit host order, red in the top 5 bits
+    Indexed8    // one palette index per pixel
+};
+
+// the two colors a pixel can be in each format
+struct Palette
+{
+    Color off = {   0,   0,   0, 255 };
+    Color on  = { 255, 255, 255, 255 };
+    byte off_index = 0;
+    byte on_index  = 1;
+};
+
+// a finished frame on its way to a presenter
+struct Frame
+{
+    cpu::Framebuffer vram;
+    uint32_t dirty_rows = 0;    // changed since the frame before
+    uint64_t number = 0;        // counts up, a gap means the rows of skipped frames are unknown
+};
+
+// takes the screen after RunFrame, frames handed over through a
+// TripleBuffer are captured straight into its Back()
+void Capture(const cpu::CPU& cpu, uint64_t number, Frame& frame);
+
+std::size_t BytesPerPixel(PixelFormat format);
+
+// writes the screen into out as 32 * scale rows of 64 * scale pixels, each
+// row stride bytes after the last. 16 or 32 pixels are expanded from their
+// bits at a time with sse2 or avx2 where the compiler targets them. only
+// screen rows set in rows are written, pass GetDirtyRows to redraw what
+// changed
+void Expand(const cpu::Framebuffer& vram, PixelFormat format, const Palette& palette,
+            std::size_t scale, void* out, std::size_t stride, uint32_t rows = ~uint32_t(0));
+
+};
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace chip8
+{
+namespace graphics
+{
+
+// hands values from one producer thread to one consumer thread without
+// locks. the producer fills Back() and publishes it with one exchange, the
+// consumer takes whatever was published last with another. neither ever
+// waits and the consumer never sees a half written value, values published
+// while the consumer wasn't looking are skipped
+template <typename T>
+class TripleBuffer
+{
+private:
+    static const uint8_t index_mask = 0x03;
+    static const uint8_t fresh = 0x04;      // middle holds a value not taken yet
+
+private:
+    std::array<T, 3> slots;
+    alignas(64) std::atomic<uint8_t> middle = { 1 };
+    alignas(64) uint8_t back = 0;           // the producer's
+    alignas(64) uint8_t front = 2;          // the consumer's
+
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer& buffer) = delete;
+    TripleBuffer(TripleBuffer&& buffer) = delete;
+
+public:
+    // producer side, Back() is only the producer's until Publish
+    T& Back() { return slots[back]; }
+
+    void Publish()
+    {
+        back = middle.exchange(back | fresh, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // consumer side, true if a newer value was taken into Front()
+    bool Update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & fresh))
+            return false;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    const T& Front() const { return slots[front]; }
+};
+
+};
+};
+
+#endif
\ No newline at end of file
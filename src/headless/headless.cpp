@@ -0,0 +1,103 @@
+#include "../cpu/cpu.hpp"
+#include "../graphics/headless.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+namespace
+{
+
+using chip8::cpu::Engine;
+using chip8::graphics::ImageFormat;
+using chip8::graphics::PixelFormat;
+
+// the backend named by output, nullptr if there's no such output
+std::unique_ptr<chip8::graphics::Backend> MakeBackend(const std::string& output, const std::string& prefix, std::size_t scale)
+{
+    if (output == "pbm")
+        return std::unique_ptr<chip8::graphics::Backend>(new chip8::graphics::ImageSequence(prefix, ImageFormat::PBM));
+    if (output == "pgm")
+        return std::unique_ptr<chip8::graphics::Backend>(new chip8::graphics::ImageSequence(prefix, ImageFormat::PGM, scale));
+    if (output == "ppm")
+        return std::unique_ptr<chip8::graphics::Backend>(new chip8::graphics::ImageSequence(prefix, ImageFormat::PPM, scale));
+    if (output == "raw")
+        return std::unique_ptr<chip8::graphics::Backend>(new chip8::graphics::RawStream(stdout));
+
+    // raw video on stdout, gray levels come from the palette colors
+    chip8::graphics::Palette gray;
+    gray.off_index = 0;
+    gray.on_index = 255;
+    if (output == "gray")
+        return std::unique_ptr<chip8::graphics::Backend>(new chip8::graphics::RawStream(stdout, PixelFormat::Indexed8, scale, gray));
+    if (output == "rgba")
+        return std::unique_ptr<chip8::graphics::Backend>(new chip8::graphics::RawStream(stdout, PixelFormat::RGBA32, scale));
+    return nullptr;
+}
+
+}
+
+// usage: chip8-headless [-f frames] [-i instructions_per_frame] [-e engine] [-s seed]
+//                       [-o pbm|pgm|ppm|raw|gray|rgba] [-x scale] [-p prefix] rom
+// runs a rom without a window and writes every frame. pbm, pgm and ppm
+// write prefix000001.ppm and on, raw writes the packed vram rows to stdout
+// and gray and rgba write expanded frames to stdout, for example into
+// ffmpeg -f rawvideo -pix_fmt gray -s 64x32 -i -
+int main(int argc, char** argv)
+{
+    std::size_t frames = 600;
+    std::size_t instructions_per_frame = 10;
+    std::size_t scale = 1;
+    Engine engine = Engine::Predecoded;
+    uint64_t seed = 0;
+    std::string output = "ppm";
+    std::string prefix = "frame-";
+
+    // an unknown flag or engine name shows the usage instead of running
+    bool valid = true;
+    int arg = 1;
+    for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2)
+    {
+        const char* value = argv[arg + 1];
+        switch (argv[arg][1])
+        {
+            case 'f': frames = std::atol(value); break;
+            case 'i': instructions_per_frame = std::max(1l, std::atol(value)); break;
+            case 'x': scale = std::max(1l, std::atol(value)); break;
+            case 's': seed = std::strtoull(value, nullptr, 0); break;
+            case 'o': output = value; break;
+            case 'p': prefix = value; break;
+            case 'e': valid = chip8::cpu::ParseEngine(value, engine) && valid; break;
+            default:  valid = false; break;
+        }
+    }
+
+    auto backend = MakeBackend(output, prefix, scale);
+    if (!valid || arg != argc - 1 || backend == nullptr)
+    {
+        std::fprintf(stderr, "usage: %s [-f frames] [-i instructions_per_frame] [-e engine] [-s seed] "
+                             "[-o pbm|pgm|ppm|raw|gray|rgba] [-x scale] [-p prefix] rom\n", argv[0]);
+        return 1;
+    }
+
+    chip8::cpu::CPU cpu(engine);
+    cpu.Seed(seed);
+    if (!cpu.LoadROM(argv[arg]))
+        return 1;
+
+    chip8::graphics::Frame frame;
+    for (std::size_t number = 1; number <= frames; number++)
+    {
+        cpu.RunFrame(instructions_per_frame);
+        chip8::graphics::Capture(cpu, number, frame);
+
+        if (!backend->Present(frame))
+        {
+            std::fprintf(stderr, "couldn't write frame %zu\n", number);
+            return 2;
+        }
+    }
+
+    return 0;
+}
\ No newline at end of file
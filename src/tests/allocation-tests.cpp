@@ -0,0 +1,196 @@
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#define private public      // this is for testing only 
+#include "../cpu/cpu.hpp"
+#include "../cpu/cpu-pool.hpp"
+#include "../env/environment.hpp"
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"     // new and delete below are malloc and free
+#endif
+
+// every allocation in the test program goes through here, only the ones made
+// while counting is on are counted
+namespace
+{
+std::atomic<bool> counting = { false };
+std::atomic<long> allocations = { 0 };
+}
+
+void* operator new(std::size_t size)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void* memory = std::malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace
+{
+
+// every opcode family the opcode tests cover, looping forever
+const std::array<chip8::cpu::byte, 0x44> opcode_rom =
+{
+    0x00, 0xe0,     // 200: clear
+    0x60, 0x00,     // 202: v[0] = 0
+    0x61, 0x01,     // 204: v[1] = 1
+    0x80, 0x14,     // 206: v[0] += v[1]
+    0x81, 0x23,     // 208: v[1] ^= v[2]
+    0x82, 0x12,     // 20a: v[2] &= v[1]
+    0x83, 0x06,     // 20c: v[3] >>= 1
+    0x83, 0x0e,     // 20e: v[3] <<= 1
+    0x84, 0x05,     // 210: v[4] -= v[0]
+    0x84, 0x07,     // 212: v[4] = v[0] - v[4]
+    0x30, 0x80,     // 214: skip if v[0] == 80
+    0x42, 0x07,     // 216: skip if v[2] != 7
+    0x50, 0x10,     // 218: skip if v[0] == v[1]
+    0x95, 0x60,     // 21a: skip if v[5] != v[6]
+    0x71, 0x03,     // 21c: v[1] += 3
+    0xa3, 0x00,     // 21e: I = 300
+    0xf4, 0x33,     // 220: bcd v[4]
+    0xf3, 0x55,     // 222: ram[I] = v[0..3]
+    0xf3, 0x65,     // 224: v[0..3] = ram[I]
+    0xf1, 0x1e,     // 226: I += v[1]
+    0xa3, 0x00,     // 228: I = 300
+    0xc1, 0x0f,     // 22a: v[1] = rand & f
+    0xf0, 0x29,     // 22c: I = font v[0]
+    0xd1, 0x25,     // 22e: draw
+    0xe1, 0x9e,     // 230: skip if key v[1]
+    0xe1, 0xa1,     // 232: skip if not key v[1]
+    0xf0, 0x07,     // 234: v[0] = delay
+    0xf0, 0x15,     // 236: delay = v[0]
+    0xf0, 0x18,     // 238: sound = v[0]
+    0x22, 0x40,     // 23a: call 240
+    0x12, 0x06,     // 23c: jump 206
+    0x12, 0x06,     // 23e: jump 206
+    0x8a, 0xb8,     // 240: unknown
+    0x00, 0xee      // 242: return
+};
+
+const chip8::cpu::Engine all_engines[] =
+{
+    chip8::cpu::Engine::Interpreter, chip8::cpu::Engine::Predecoded, chip8::cpu::Engine::Table,
+    chip8::cpu::Engine::Threaded,    chip8::cpu::Engine::Jit
+};
+
+}
+
+#pragma region allocation
+
+TEST_CASE("cycle doesn't allocate", "[cpu-class][allocation]")
+{
+    for (auto engine : all_engines)
+    {
+        chip8::cpu::CPU cpu(engine);
+        cpu.LoadROM(opcode_rom.data(), opcode_rom.size());
+
+        allocations = 0;
+        counting = true;
+        for (int i = 0; i < 1000000; i++)
+            cpu.Cycle();
+        counting = false;
+
+        INFO(int(engine) << " engine");
+        REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::UnknownOpcode) > 0);
+        REQUIRE(allocations == 0);
+    }
+}
+
+TEST_CASE("run frame doesn't allocate", "[cpu-class][allocation]")
+{
+    for (auto engine : all_engines)
+    {
+        chip8::cpu::CPU cpu(engine);
+        cpu.LoadROM(opcode_rom.data(), opcode_rom.size());
+
+        allocations = 0;
+        counting = true;
+        for (int i = 0; i < 1000; i++)
+            cpu.RunFrame(1000);
+        counting = false;
+
+        INFO(int(engine) << " engine");
+        REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::UnknownOpcode) > 0);
+        REQUIRE(allocations == 0);
+    }
+}
+
+TEST_CASE("env step doesn't allocate", "[cpu-class][allocation]")
+{
+    for (auto engine : all_engines)
+    {
+        chip8::env::Config config;
+        config.engine = engine;
+        config.max_frames = 50;
+        chip8::env::VectorEnv env(8, opcode_rom.data(), opcode_rom.size(), config);
+
+        std::vector<chip8::cpu::byte> observations(env.Size() * chip8::env::VectorEnv::observation_size);
+        std::vector<uint16_t> keys(env.Size(), 0x0002);
+        std::vector<float> rewards(env.Size());
+        std::vector<chip8::cpu::byte> dones(env.Size());
+
+        allocations = 0;
+        counting = true;
+        for (int i = 0; i < 200; i++)
+            env.Step(keys.data(), observations.data(), rewards.data(), dones.data());
+        counting = false;
+
+        INFO(int(engine) << " engine");
+        REQUIRE(allocations == 0);
+    }
+}
+
+// predecoded clones copy their decode caches and jit clones get a jit of
+// their own, the engines without caches only take slots and pages
+TEST_CASE("cpu pool acquire and clone don't allocate", "[cpu-class][allocation]")
+{
+    const chip8::cpu::Engine engines[] =
+    {
+        chip8::cpu::Engine::Interpreter, chip8::cpu::Engine::Table, chip8::cpu::Engine::Threaded
+    };
+
+    for (auto engine : engines)
+    {
+        chip8::cpu::CPUPool pool(16);
+        chip8::cpu::CPU original(engine);
+        original.LoadROM(opcode_rom.data(), opcode_rom.size());
+        original.RunFrame(1000);
+
+        allocations = 0;
+        counting = true;
+        chip8::cpu::CPU* acquired = pool.Acquire(engine);
+        acquired->ram.Write(0x300, 0xab);
+        while (chip8::cpu::CPU* clone = pool.Clone(original))
+        {
+            clone->RunFrame(1000);
+            clone->ram.Write(0x300, 0xab);
+        }
+        counting = false;
+
+        INFO(int(engine) << " engine");
+        REQUIRE(pool.Size() == pool.Capacity());
+        REQUIRE(pool.At(15)->ram.OwnedPages() > 0);
+        REQUIRE(allocations == 0);
+    }
+}
+
+#pragma endregion
\ No newline at end of file
@@ -1,7 +1,14 @@
 #include <catch2/catch.hpp>
 
+#include <sstream>
+#include <thread>
+#include <vector>
+
 #define private public      // this is for testing only 
 #include "../cpu/cpu.hpp"
+#include "../cpu/fault-log.hpp"
+#include "../cpu/cpu-pool.hpp"
+#include "../cpu/rewind.hpp"
 
 #pragma region init
 
@@ -119,6 +126,65 @@ TEST_CASE("cpu getxindex / getyindex", "[cpu-class][func]")
     REQUIRE(cpu.GetYIndex() == 4);
 }
 
+TEST_CASE("cpu reset", "[cpu-class][func]")
+{
+    const std::array<chip8::cpu::byte, 6> rom =
+    {
+        0x61, 0x05,     // 200: v[1] = 5
+        0xa3, 0x00,     // 202: I = 300
+        0x00, 0x00      // 204: unknown
+    };
+
+    chip8::cpu::CPU fresh(chip8::cpu::Engine::Predecoded);
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+    cpu.LoadROM(rom.data(), rom.size());
+    cpu.RunCycles(3);
+    cpu.keyboard[3] = 1;
+    cpu.vram[10] = 1 << 3;
+
+    cpu.Reset();
+
+    REQUIRE(cpu.registers.pc == fresh.registers.pc);
+    REQUIRE(cpu.registers.index == fresh.registers.index);
+    REQUIRE(cpu.registers.variable == fresh.registers.variable);
+    REQUIRE(cpu.ram == fresh.ram);
+    REQUIRE(cpu.vram == fresh.vram);
+    REQUIRE(cpu.keyboard == fresh.keyboard);
+    REQUIRE(cpu.decoded.empty());
+    REQUIRE(cpu.GetLastFault() == chip8::cpu::Fault::None);
+    REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::UnknownOpcode) == 0);
+
+    // and runs a rom again like a new cpu
+    cpu.LoadROM(rom.data(), rom.size());
+    cpu.RunCycles(2);
+    REQUIRE(cpu.registers.variable[1] == 5);
+    REQUIRE(cpu.registers.index == 0x300);
+}
+
+TEST_CASE("cpu vram hash", "[cpu-class][func]")
+{
+    chip8::cpu::CPU blank;
+    chip8::cpu::CPU cpu;
+
+    SECTION("left column pixels change the hash")
+    {
+        cpu.vram[5] = uint64_t(1) << 63;
+        cpu.vram[6] = uint64_t(1) << 63;
+
+        REQUIRE(cpu.GetPixel(0, 5));
+        REQUIRE(cpu.GetVRAMHash() != blank.GetVRAMHash());
+    }
+
+    SECTION("the same pixel on another row hashes differently")
+    {
+        chip8::cpu::CPU other;
+        cpu.vram[5] = 1;
+        other.vram[6] = 1;
+
+        REQUIRE(cpu.GetVRAMHash() != other.GetVRAMHash());
+    }
+}
+
 TEST_CASE("cpu push / pop", "[cpu-class][func]")
 {
     chip8::cpu::CPU cpu;
@@ -140,6 +206,526 @@ TEST_CASE("cpu push / pop", "[cpu-class][func]")
         REQUIRE(cpu.registers.pc == 0x305);
         REQUIRE(cpu.registers.stack_pointer == 0);
     }
+
+    SECTION("push full")
+    {
+        cpu.registers.stack_pointer = 16;
+
+        REQUIRE_FALSE(cpu.Push());
+        REQUIRE(cpu.registers.stack_pointer == 16);
+    }
+
+    SECTION("pop empty")
+    {
+        REQUIRE_FALSE(cpu.Pop());
+        REQUIRE(cpu.registers.pc == 0x0200);
+    }
+}
+
+#pragma endregion
+
+
+#pragma region fault
+
+TEST_CASE("cpu fault callback", "[cpu-class][fault]")
+{
+    struct Seen
+    {
+        chip8::cpu::Fault fault;
+        chip8::cpu::word pc;
+        chip8::cpu::word opcode;
+    };
+
+    std::vector<Seen> seen;
+    chip8::cpu::CPU cpu;
+    cpu.SetFaultCallback([](void* user, chip8::cpu::Fault fault, chip8::cpu::word pc, chip8::cpu::word opcode)
+    {
+        static_cast<std::vector<Seen>*>(user)->push_back({ fault, pc, opcode });
+    }, &seen);
+
+    cpu.ram[0x0200] = 0x8a;
+    cpu.ram[0x0201] = 0xb8;
+    cpu.ram[0x0202] = 0x00;
+    cpu.ram[0x0203] = 0xee;
+    cpu.Cycle();
+    cpu.Cycle();
+
+    REQUIRE(seen.size() == 2);
+    REQUIRE(seen[0].fault == chip8::cpu::Fault::UnknownOpcode);
+    REQUIRE(seen[0].pc == 0x0200);
+    REQUIRE(seen[0].opcode == 0x8ab8);
+    REQUIRE(seen[1].fault == chip8::cpu::Fault::StackUnderflow);
+    REQUIRE(seen[1].pc == 0x0202);
+
+    REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::UnknownOpcode) == 1);
+    REQUIRE(cpu.GetLastFault() == chip8::cpu::Fault::StackUnderflow);
+
+    cpu.ClearFaults();
+    REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::UnknownOpcode) == 0);
+    REQUIRE(cpu.GetLastFault() == chip8::cpu::Fault::None);
+}
+
+TEST_CASE("cpu fault log", "[cpu-class][fault]")
+{
+    std::ostringstream out;
+
+    {
+        chip8::cpu::FaultLog log(out);
+        chip8::cpu::CPU cpu;
+        log.Attach(cpu);
+
+        cpu.ram[0x0200] = 0x8a;
+        cpu.ram[0x0201] = 0xb8;
+        cpu.ram[0x0202] = 0x12;
+        cpu.ram[0x0203] = 0x00;
+        cpu.RunCycles(4);
+
+        REQUIRE(log.Dropped() == 0);
+    }
+
+    REQUIRE(out.str() == "200: 8ab8 unknown opcode\n200: 8ab8 unknown opcode\n");
+}
+
+#pragma endregion
+
+#pragma region copy
+
+namespace
+{
+
+// counts v[0] up forever and draws it
+const std::array<chip8::cpu::byte, 10> copy_rom =
+{
+    0x70, 0x01,     // 200: v[0] += 1
+    0xf0, 0x29,     // 202: I = font v[0]
+    0xd1, 0x25,     // 204: draw
+    0x81, 0x04,     // 206: v[1] += v[0]
+    0x12, 0x00      // 208: jump 200
+};
+
+void RequireSameState(const chip8::cpu::CPU& a, const chip8::cpu::CPU& b)
+{
+    REQUIRE(a.registers.pc == b.registers.pc);
+    REQUIRE(a.registers.index == b.registers.index);
+    REQUIRE(a.registers.variable == b.registers.variable);
+    REQUIRE(a.ram == b.ram);
+    REQUIRE(a.vram == b.vram);
+}
+
+}
+
+TEST_CASE("cpu copy", "[cpu-class][copy]")
+{
+    const chip8::cpu::Engine engines[] =
+    {
+        chip8::cpu::Engine::Interpreter, chip8::cpu::Engine::Predecoded, chip8::cpu::Engine::Table,
+        chip8::cpu::Engine::Threaded,    chip8::cpu::Engine::Jit
+    };
+
+    for (auto engine : engines)
+    {
+        INFO(int(engine) << " engine");
+
+        chip8::cpu::CPU original(engine);
+        original.LoadROM(copy_rom.data(), copy_rom.size());
+        original.RunCycles(1001);
+
+        SECTION("copies run the same as the original")
+        {
+            chip8::cpu::CPU copy(original);
+            RequireSameState(original, copy);
+
+            original.RunCycles(5000);
+            copy.RunCycles(5000);
+            RequireSameState(original, copy);
+        }
+
+        SECTION("assigned copies run the same as the original")
+        {
+            chip8::cpu::CPU copy(engine);
+            copy = original;
+
+            original.RunCycles(5000);
+            copy.RunCycles(5000);
+            RequireSameState(original, copy);
+        }
+
+        SECTION("moves keep the state")
+        {
+            chip8::cpu::CPU copy(original);
+            chip8::cpu::CPU moved(std::move(copy));
+
+            original.RunCycles(5000);
+            moved.RunCycles(5000);
+            RequireSameState(original, moved);
+        }
+    }
+}
+
+TEST_CASE("cpu copy keeps random state", "[cpu-class][copy]")
+{
+    const std::array<chip8::cpu::byte, 4> rom =
+    {
+        0xc1, 0xff,     // 200: v[1] = rand
+        0x12, 0x00      // 202: jump 200
+    };
+
+    chip8::cpu::CPU original;
+    original.Seed(99);
+    original.LoadROM(rom.data(), rom.size());
+    original.RunCycles(11);
+
+    chip8::cpu::CPU copy(original);
+    for (int i = 0; i < 50; i++)
+    {
+        original.Cycle();
+        copy.Cycle();
+        REQUIRE(original.registers.variable[1] == copy.registers.variable[1]);
+    }
+}
+
+TEST_CASE("cpu in vector", "[cpu-class][copy]")
+{
+    std::vector<chip8::cpu::CPU> cpus;
+    for (int i = 0; i < 8; i++)
+    {
+        cpus.emplace_back(chip8::cpu::Engine::Predecoded);
+        cpus.back().LoadROM(copy_rom.data(), copy_rom.size());
+        cpus.back().RunCycles(i * 5);
+    }
+
+    for (int i = 0; i < 8; i++)
+        REQUIRE(cpus[i].registers.variable[0] == i);
+}
+
+TEST_CASE("cpu pool", "[cpu-class][copy]")
+{
+    chip8::cpu::CPUPool pool(3);
+    REQUIRE(pool.Capacity() == 3);
+
+    chip8::cpu::CPU* a = pool.Acquire(chip8::cpu::Engine::Predecoded);
+    a->LoadROM(copy_rom.data(), copy_rom.size());
+    a->RunCycles(100);
+
+    chip8::cpu::CPU* b = pool.Clone(*a);
+    chip8::cpu::CPU* c = pool.Acquire();
+    REQUIRE(pool.Size() == 3);
+    REQUIRE(pool.Acquire() == nullptr);
+
+    // slots are contiguous
+    REQUIRE(pool.At(0) == a);
+    REQUIRE(pool.At(1) == b);
+    REQUIRE(pool.At(2) == c);
+
+    a->RunCycles(100);
+    b->RunCycles(100);
+    RequireSameState(*a, *b);
+
+    pool.Release(b);
+    REQUIRE(pool.Size() == 2);
+    REQUIRE(pool.At(1) == nullptr);
+    REQUIRE(pool.Acquire() == b);
+}
+
+#pragma endregion
+
+#pragma region state
+
+TEST_CASE("cpu save and load state", "[cpu-class][state]")
+{
+    const chip8::cpu::Engine engines[] =
+    {
+        chip8::cpu::Engine::Interpreter, chip8::cpu::Engine::Predecoded, chip8::cpu::Engine::Table,
+        chip8::cpu::Engine::Threaded,    chip8::cpu::Engine::Jit
+    };
+
+    for (auto engine : engines)
+    {
+        chip8::cpu::CPU cpu(engine);
+        cpu.Seed(5);
+        cpu.LoadROM(copy_rom.data(), copy_rom.size());
+        cpu.RunCycles(37);
+        cpu.SetKey(3, true);
+
+        chip8::cpu::State state;
+        cpu.SaveState(state);
+
+        chip8::cpu::CPU expected(cpu);
+        expected.RunCycles(200);
+        cpu.RunCycles(50);
+
+        // rolls back over everything that ran since the save
+        REQUIRE(cpu.LoadState(state));
+        REQUIRE(cpu.keyboard[3] == 1);
+        REQUIRE(cpu.random.GetState() == expected.random.GetState());
+        cpu.RunCycles(200);
+        RequireSameState(cpu, expected);
+    }
+}
+
+TEST_CASE("cpu load state into another engine", "[cpu-class][state]")
+{
+    chip8::cpu::Quirks quirks;
+    quirks.super_chip = true;
+
+    chip8::cpu::CPU source(chip8::cpu::Engine::Interpreter, quirks);
+    source.LoadROM(copy_rom.data(), copy_rom.size());
+    source.RunCycles(100);
+
+    chip8::cpu::State state;
+    source.SaveState(state);
+
+    chip8::cpu::CPU target(chip8::cpu::Engine::Predecoded);
+    REQUIRE(target.LoadState(state));
+    REQUIRE(target.quirks.super_chip);
+    REQUIRE(target.size_of_rom == copy_rom.size());
+
+    source.RunCycles(100);
+    target.RunCycles(100);
+    RequireSameState(source, target);
+}
+
+TEST_CASE("cpu load state only decodes changed code", "[cpu-class][state]")
+{
+    const chip8::cpu::Handler stale = &chip8::cpu::CPU::Redecode;
+
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+    cpu.LoadROM(copy_rom.data(), copy_rom.size());
+
+    chip8::cpu::State state;
+    cpu.SaveState(state);
+    cpu.RunCycles(50);
+
+    // nothing in ram changed so nothing is decoded again
+    cpu.decoded[1].handler = stale;
+    REQUIRE(cpu.LoadState(state));
+    REQUIRE(cpu.decoded[0].handler != stale);
+    REQUIRE(cpu.decoded[1].handler == stale);
+
+    // the rom page changed so its slots decode again when they run
+    state.ram[0x200] = 0x71;        // 200: v[1] += 1
+    REQUIRE(cpu.LoadState(state));
+    REQUIRE(cpu.decoded[0].handler == stale);
+    cpu.RunCycles(1);
+    REQUIRE(cpu.registers.variable[1] == 1);
+    REQUIRE(cpu.registers.variable[0] == 0);
+
+    // other quirks decode the whole rom again
+    state.quirks ^= 1;
+    REQUIRE(cpu.LoadState(state));
+    REQUIRE(cpu.quirks.super_chip);
+    REQUIRE(cpu.decoded[1].handler != stale);
+}
+
+TEST_CASE("cpu load state rejects other versions", "[cpu-class][state]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.LoadROM(copy_rom.data(), copy_rom.size());
+    cpu.RunCycles(10);
+
+    chip8::cpu::State state;
+    cpu.SaveState(state);
+    state.version++;
+
+    chip8::cpu::CPU fresh;
+    REQUIRE_FALSE(fresh.LoadState(state));
+    REQUIRE(fresh.registers.pc == 0x200);
+    REQUIRE(fresh.size_of_rom == 0);
+
+    state.version--;
+    state.magic = 0;
+    REQUIRE_FALSE(fresh.LoadState(state));
 }
 
 #pragma endregion
+
+
+#pragma region rewind
+
+TEST_CASE("rewind buffer", "[cpu-class][rewind]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+    cpu.LoadROM(copy_rom.data(), copy_rom.size());
+
+    chip8::cpu::RewindBuffer rewind(100, 64 * 1024, 10);
+    std::vector<chip8::cpu::CPU> history;
+    for (int frame = 0; frame < 50; frame++)
+    {
+        cpu.RunFrame(7);
+        rewind.Push(cpu);
+        history.push_back(cpu);
+    }
+    REQUIRE(rewind.Size() == 50);
+
+    // deltas are much smaller than full states
+    REQUIRE(rewind.BytesUsed() < 50 * sizeof(chip8::cpu::State) / 4);
+
+    REQUIRE(rewind.Rewind(cpu, 0));
+    RequireSameState(cpu, history[49]);
+    REQUIRE(rewind.Rewind(cpu, 13));
+    RequireSameState(cpu, history[36]);
+    REQUIRE(rewind.Size() == 37);
+    REQUIRE_FALSE(rewind.Rewind(cpu, 37));
+
+    // history carries on from the rewound frame
+    for (int frame = 0; frame < 20; frame++)
+    {
+        cpu.RunFrame(7);
+        rewind.Push(cpu);
+    }
+    REQUIRE(rewind.Rewind(cpu, 20));
+    RequireSameState(cpu, history[36]);
+    REQUIRE(rewind.Rewind(cpu, 5));
+    RequireSameState(cpu, history[31]);
+}
+
+TEST_CASE("rewind buffer drops oldest", "[cpu-class][rewind]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.LoadROM(copy_rom.data(), copy_rom.size());
+
+    // only room for a couple of keyframes and their deltas
+    chip8::cpu::RewindBuffer rewind(30, 4 * 1024, 8);
+    std::vector<chip8::cpu::CPU> history;
+    for (int frame = 0; frame < 500; frame++)
+    {
+        cpu.RunFrame(5);
+        rewind.Push(cpu);
+        history.push_back(cpu);
+
+        REQUIRE(rewind.Size() > 0);
+        REQUIRE(rewind.Size() <= 30);
+        REQUIRE(rewind.BytesUsed() <= sizeof(chip8::cpu::State) + 4);
+    }
+
+    std::size_t kept = rewind.Size();
+    REQUIRE(rewind.Rewind(cpu, kept - 1));
+    RequireSameState(cpu, history[500 - kept]);
+
+    rewind.Clear();
+    REQUIRE(rewind.Size() == 0);
+    REQUIRE_FALSE(rewind.Rewind(cpu));
+}
+
+#pragma endregion
+
+
+#pragma region memory
+
+TEST_CASE("ram pages are shared until written", "[cpu-class][memory]")
+{
+    chip8::cpu::CPU a;
+    chip8::cpu::CPU b;
+
+    // the font and untouched pages are shared from the start
+    REQUIRE(a.ram.OwnedPages() == 0);
+    REQUIRE(a.ram.Read(0x05) == 0x20);
+
+    // loading a rom freezes its pages so copies share them
+    a.LoadROM(copy_rom.data(), copy_rom.size());
+    REQUIRE(a.ram.OwnedPages() == 0);
+
+    chip8::cpu::CPU clone(a);
+    REQUIRE(clone.ram.OwnedPages() == 0);
+    REQUIRE(clone.ram.pages[2] == a.ram.pages[2]);
+    REQUIRE(clone.ram == a.ram);
+
+    clone.ram.Write(0x300, 0xab);
+    REQUIRE(clone.ram.OwnedPages() == 1);
+    REQUIRE(clone.ram.Read(0x300) == 0xab);
+    REQUIRE(a.ram.Read(0x300) == 0x00);
+    REQUIRE(b.ram.Read(0x300) == 0x00);
+    REQUIRE(clone.ram != a.ram);
+
+    // writing the same bytes again doesn't copy the page
+    const chip8::cpu::byte same[] = { copy_rom[0], copy_rom[1] };
+    clone.ram.Write(0x200, same, 2);
+    REQUIRE(clone.ram.OwnedPages() == 1);
+
+    clone.Reset();
+    REQUIRE(clone.ram == b.ram);
+}
+
+TEST_CASE("ram moves leave the source cleared", "[cpu-class][memory]")
+{
+    chip8::cpu::PageArena arena;
+    chip8::cpu::Memory a(&arena);
+    REQUIRE(arena.PagesInUse() == 0);
+
+    a.Write(0x300, 0xab);
+    REQUIRE(arena.PagesInUse() == 1);
+
+    chip8::cpu::Memory b(std::move(a));
+    REQUIRE(b.Read(0x300) == 0xab);
+    REQUIRE(a.OwnedPages() == 0);
+    REQUIRE(a == chip8::cpu::Memory());
+
+    // the moved from memory can still be written and assigned to
+    a.Write(0x400, 0xcd);
+    REQUIRE(a.Read(0x400) == 0xcd);
+    REQUIRE(arena.PagesInUse() == 2);
+
+    a = std::move(b);
+    REQUIRE(a.Read(0x300) == 0xab);
+    REQUIRE(a.Read(0x400) == 0x00);
+    REQUIRE(b.OwnedPages() == 0);
+    REQUIRE(arena.PagesInUse() == 1);
+
+    // memories from other arenas copy the pages instead of taking them
+    chip8::cpu::Memory c;
+    c = std::move(a);
+    REQUIRE(c.Read(0x300) == 0xab);
+    REQUIRE(arena.PagesInUse() == 0);
+}
+
+TEST_CASE("ram clones write on their own threads", "[cpu-class][memory]")
+{
+    chip8::cpu::CPU original;
+    original.LoadROM(copy_rom.data(), copy_rom.size());
+
+    // every clone writes the rom page they share, each into its own copy
+    std::vector<chip8::cpu::CPU> clones(4, original);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < clones.size(); i++)
+    {
+        threads.emplace_back([&clones, i]()
+        {
+            for (int n = 0; n < 10000; n++)
+                clones[i].ram.Write(0x200 + n % 0x100, chip8::cpu::byte(i + n));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    REQUIRE(original.ram.Read(0x200) == copy_rom[0]);
+    for (std::size_t i = 0; i < clones.size(); i++)
+    {
+        REQUIRE(clones[i].ram.OwnedPages() == 1);
+        REQUIRE(clones[i].ram.Read(0x200) == chip8::cpu::byte(i + 9984));
+    }
+}
+
+TEST_CASE("cpu pool shares rom pages", "[cpu-class][memory]")
+{
+    chip8::cpu::CPUPool pool(64);
+
+    chip8::cpu::CPU* first = pool.Acquire(chip8::cpu::Engine::Predecoded);
+    first->LoadROM(copy_rom.data(), copy_rom.size());
+    while (pool.Clone(*first) != nullptr);
+
+    for (std::size_t i = 0; i < pool.Size(); i++)
+        pool.At(i)->RunCycles(100 + i);
+
+    // copy_rom never writes ram so every clone still runs on first's pages
+    std::size_t owned = 0;
+    for (std::size_t i = 0; i < pool.Size(); i++)
+        owned += pool.At(i)->ram.OwnedPages();
+    REQUIRE(owned == 0);
+
+    chip8::cpu::CPU expected(chip8::cpu::Engine::Predecoded);
+    expected.LoadROM(copy_rom.data(), copy_rom.size());
+    expected.RunCycles(163);
+    RequireSameState(*pool.At(63), expected);
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,705 @@
+#include <catch2/catch.hpp>
+
+#define private public      // this is for testing only
+#include "../cpu/cpu.hpp"
+#include "../cpu/cpu-batch.hpp"
+
+#include <memory>
+
+#pragma region predecoded
+
+// counts v[0] up to 10 in v[1] steps, stores it and draws a font character
+const std::array<chip8::cpu::byte, 0x16> counter_rom =
+{
+    0x60, 0x00,     // 200: v[0] = 0
+    0x61, 0x01,     // 202: v[1] = 1
+    0x80, 0x14,     // 204: v[0] += v[1]
+    0x30, 0x0a,     // 206: skip if v[0] == 10
+    0x12, 0x04,     // 208: jump 204
+    0xa3, 0x00,     // 20a: I = 300
+    0xf0, 0x33,     // 20c: bcd v[0]
+    0xf0, 0x29,     // 20e: I = font v[0]
+    0xd0, 0x15,     // 210: draw
+    0x12, 0x14,     // 212: jump 214
+    0x12, 0x14      // 214: jump 214
+};
+
+// runs counter_rom on the interpreter and on engine side by side
+void RequireMatchesInterpreter(chip8::cpu::Engine engine)
+{
+    chip8::cpu::CPU interpreter(chip8::cpu::Engine::Interpreter);
+    chip8::cpu::CPU other(engine);
+
+    interpreter.LoadROM(counter_rom.data(), counter_rom.size());
+    other.LoadROM(counter_rom.data(), counter_rom.size());
+
+    for (int i = 0; i < 100; i++)
+    {
+        interpreter.Cycle();
+        other.Cycle();
+
+        INFO(i);
+        REQUIRE(interpreter.current_opcode == other.current_opcode);
+        REQUIRE(interpreter.registers.pc == other.registers.pc);
+        REQUIRE(interpreter.registers.index == other.registers.index);
+        REQUIRE(interpreter.registers.variable == other.registers.variable);
+    }
+
+    REQUIRE(interpreter.ram == other.ram);
+    REQUIRE(interpreter.vram == other.vram);
+}
+
+// runs counter_rom for cycles with RunCycles on engine and one at a time on the interpreter
+void RequireRunCyclesMatchesInterpreter(chip8::cpu::Engine engine, int cycles)
+{
+    chip8::cpu::CPU interpreter(chip8::cpu::Engine::Interpreter);
+    chip8::cpu::CPU other(engine);
+
+    interpreter.LoadROM(counter_rom.data(), counter_rom.size());
+    other.LoadROM(counter_rom.data(), counter_rom.size());
+
+    for (int i = 0; i < cycles; i++)
+        interpreter.Cycle();
+    other.RunCycles(cycles);
+
+    INFO(cycles);
+    REQUIRE(interpreter.current_opcode == other.current_opcode);
+    REQUIRE(interpreter.registers.pc == other.registers.pc);
+    REQUIRE(interpreter.registers.index == other.registers.index);
+    REQUIRE(interpreter.registers.variable == other.registers.variable);
+    REQUIRE(interpreter.ram == other.ram);
+    REQUIRE(interpreter.vram == other.vram);
+}
+
+TEST_CASE("predecoded matches interpreter", "[cpu-class][engine]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+    cpu.LoadROM(counter_rom.data(), counter_rom.size());
+
+    REQUIRE(cpu.decoded.size() == counter_rom.size());
+    RequireMatchesInterpreter(chip8::cpu::Engine::Predecoded);
+}
+
+TEST_CASE("predecoded sees rom writes", "[cpu-class][engine]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+
+    const std::array<chip8::cpu::byte, 8> rom =
+    {
+        0xa2, 0x06,     // 200: I = 206
+        0xf1, 0x55,     // 202: store v[0], v[1] at 206
+        0x12, 0x06,     // 204: jump 206
+        0x00, 0xe0      // 206: overwritten before it runs
+    };
+    cpu.LoadROM(rom.data(), rom.size());
+    cpu.registers.variable[0] = 0x63;
+    cpu.registers.variable[1] = 0x42;
+
+    // decode the old instruction at 206 before it's overwritten
+    cpu.registers.pc = 0x0206;
+    cpu.Cycle();
+    REQUIRE(cpu.current_opcode == 0x00e0);
+
+    cpu.registers.pc = 0x0200;
+    for (int i = 0; i < 4; i++)
+        cpu.Cycle();
+
+    REQUIRE(cpu.current_opcode == 0x6342);
+    REQUIRE(cpu.registers.variable[3] == 0x42);
+}
+
+TEST_CASE("predecoded falls back outside the rom", "[cpu-class][engine]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+
+    const std::array<chip8::cpu::byte, 2> rom = { 0x13, 0x00 };   // jump 300
+    cpu.LoadROM(rom.data(), rom.size());
+    cpu.ram[0x0300] = 0x65;
+    cpu.ram[0x0301] = 0x12;
+
+    cpu.Cycle();
+    cpu.Cycle();
+
+    REQUIRE(cpu.registers.pc == 0x0302);
+    REQUIRE(cpu.registers.variable[5] == 0x12);
+}
+
+#pragma endregion
+
+#pragma region table
+
+TEST_CASE("handler table matches decode", "[cpu-class][engine]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Table);
+    const chip8::cpu::HandlerTable& table = *cpu.handler_table;
+
+    for (int opcode = 0; opcode <= 0xffff; opcode++)
+    {
+        INFO(opcode);
+        REQUIRE(table[opcode >> 12][opcode & 0xff] == cpu.DecodeInstruction(opcode).handler);
+    }
+}
+
+TEST_CASE("table matches interpreter", "[cpu-class][engine]")
+{
+    RequireMatchesInterpreter(chip8::cpu::Engine::Table);
+}
+
+#pragma endregion
+
+#pragma region threaded
+
+TEST_CASE("threaded matches interpreter", "[cpu-class][engine]")
+{
+    RequireMatchesInterpreter(chip8::cpu::Engine::Threaded);
+}
+
+TEST_CASE("threaded runcycles matches interpreter", "[cpu-class][engine]")
+{
+    for (int cycles : { 1, 7, 37, 100 })
+        RequireRunCyclesMatchesInterpreter(chip8::cpu::Engine::Threaded, cycles);
+}
+
+#pragma endregion
+
+#pragma region jit
+
+// Cycle() always interprets, the jit only runs through RunCycles
+TEST_CASE("jit matches interpreter", "[cpu-class][engine]")
+{
+    for (int cycles : { 1, 2, 7, 37, 100 })
+        RequireRunCyclesMatchesInterpreter(chip8::cpu::Engine::Jit, cycles);
+}
+
+TEST_CASE("jit sees rom writes", "[cpu-class][engine]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Jit);
+
+    const std::array<chip8::cpu::byte, 10> rom =
+    {
+        0x60, 0x64,     // 200: v[0] = 64
+        0x61, 0x42,     // 202: v[1] = 42
+        0xa2, 0x08,     // 204: I = 208
+        0xf1, 0x55,     // 206: store v[0], v[1] at 208
+        0x00, 0xe0      // 208: overwritten before it runs
+    };
+    cpu.LoadROM(rom.data(), rom.size());
+
+    // translate the block at 208 before it's overwritten
+    cpu.registers.pc = 0x0208;
+    cpu.RunCycles(1);
+    REQUIRE(cpu.current_opcode == 0x00e0);
+
+    cpu.registers.pc = 0x0200;
+    cpu.RunCycles(5);
+
+    REQUIRE(cpu.current_opcode == 0x6442);
+    REQUIRE(cpu.registers.variable[4] == 0x42);
+    REQUIRE(cpu.registers.pc == 0x020a);
+}
+
+#pragma endregion
+
+#pragma region quirks
+
+TEST_CASE("quirks pick specialized handlers", "[cpu-class][engine]")
+{
+    chip8::cpu::Quirks quirks;
+    quirks.super_chip = true;
+    quirks.new_store_load = false;
+
+    chip8::cpu::CPU plain;
+    chip8::cpu::CPU quirky(chip8::cpu::Engine::Interpreter, quirks);
+
+    REQUIRE(plain.profile != quirky.profile);
+    REQUIRE(plain.DecodeInstruction(0x8126).handler != quirky.DecodeInstruction(0x8126).handler);
+    REQUIRE(plain.DecodeInstruction(0x8124).handler == quirky.DecodeInstruction(0x8124).handler);
+
+    quirky.SetQuirks(chip8::cpu::Quirks());
+    REQUIRE(plain.profile == quirky.profile);
+}
+
+TEST_CASE("set quirks redecodes", "[cpu-class][engine]")
+{
+    for (auto engine : { chip8::cpu::Engine::Predecoded, chip8::cpu::Engine::Table,
+                         chip8::cpu::Engine::Threaded, chip8::cpu::Engine::Jit })
+    {
+        chip8::cpu::CPU cpu(engine);
+
+        const std::array<chip8::cpu::byte, 4> rom =
+        {
+            0xb1, 0x00,     // 200: jump 100 + v[0] or v[1]
+            0x12, 0x00      // 202: jump 200
+        };
+        cpu.LoadROM(rom.data(), rom.size());
+        cpu.registers.variable[0] = 0x10;
+        cpu.registers.variable[1] = 0x20;
+
+        cpu.RunCycles(1);
+        REQUIRE(cpu.registers.pc == 0x0110);
+
+        chip8::cpu::Quirks quirks;
+        quirks.super_chip = true;
+        cpu.SetQuirks(quirks);
+
+        cpu.registers.pc = 0x0200;
+        cpu.RunCycles(1);
+        REQUIRE(cpu.registers.pc == 0x0120);
+    }
+}
+
+#pragma endregion
+
+#pragma region fusion
+
+// every idiom that gets fused, with both ways out of the skips
+const std::array<chip8::cpu::byte, 0x20> fusion_rom =
+{
+    0x60, 0x00,     // 200: v[0] = 0
+    0x61, 0x05,     // 202: v[1] = 5
+    0x62, 0x00,     // 204: v[2] = 0
+    0x70, 0x01,     // 206: v[0] += 1
+    0x30, 0x0a,     // 208: skip if v[0] == 10
+    0x12, 0x06,     // 20a: jump 206
+    0xa0, 0x00,     // 20c: I = 0
+    0xd1, 0x25,     // 20e: draw
+    0x41, 0x05,     // 210: skip if v[1] != 5
+    0x12, 0x16,     // 212: jump 216
+    0x00, 0xe0,     // 214: skipped
+    0x30, 0x00,     // 216: skip if v[0] == 0
+    0x12, 0x1c,     // 218: jump 21c
+    0x00, 0xe0,     // 21a: skipped
+    0x71, 0x01,     // 21c: v[1] += 1
+    0x12, 0x00      // 21e: jump 200
+};
+
+TEST_CASE("fusion finds idioms", "[cpu-class][engine]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+    cpu.LoadROM(fusion_rom.data(), fusion_rom.size());
+
+    REQUIRE(cpu.fused[0x00].handler == &chip8::cpu::CPU::FusedSetSet);
+    REQUIRE(cpu.fused[0x02].handler == &chip8::cpu::CPU::FusedSetSet);
+    REQUIRE(cpu.fused[0x06].handler == &chip8::cpu::CPU::FusedCountLoop);
+    REQUIRE(cpu.fused[0x08].handler == &chip8::cpu::CPU::FusedSkipJump);
+    REQUIRE(cpu.fused[0x0c].handler == &chip8::cpu::CPU::FusedLoadDraw);
+    REQUIRE(cpu.fused[0x10].handler == &chip8::cpu::CPU::FusedSkipJump);
+    REQUIRE(cpu.fused[0x16].handler == &chip8::cpu::CPU::FusedSkipJump);
+    REQUIRE(cpu.fused[0x1c].handler == nullptr);
+}
+
+TEST_CASE("fusion matches interpreter", "[cpu-class][engine]")
+{
+    for (int cycles = 1; cycles < 200; cycles++)
+    {
+        chip8::cpu::CPU interpreter;
+        chip8::cpu::CPU predecoded(chip8::cpu::Engine::Predecoded);
+
+        interpreter.LoadROM(fusion_rom.data(), fusion_rom.size());
+        predecoded.LoadROM(fusion_rom.data(), fusion_rom.size());
+
+        for (int i = 0; i < cycles; i++)
+            interpreter.Cycle();
+        predecoded.RunCycles(cycles);
+
+        INFO(cycles);
+        REQUIRE(interpreter.current_opcode == predecoded.current_opcode);
+        REQUIRE(interpreter.registers.pc == predecoded.registers.pc);
+        REQUIRE(interpreter.registers.index == predecoded.registers.index);
+        REQUIRE(interpreter.registers.variable == predecoded.registers.variable);
+        REQUIRE(interpreter.vram == predecoded.vram);
+    }
+}
+
+TEST_CASE("fusion is undone by rom writes", "[cpu-class][engine]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+    cpu.LoadROM(fusion_rom.data(), fusion_rom.size());
+
+    // overwrite the jump at 20a
+    cpu.registers.index = 0x020a;
+    cpu.registers.variable[0] = 0x00;
+    cpu.registers.variable[1] = 0xe0;
+    cpu.ram[0x0300] = 0xf1;
+    cpu.ram[0x0301] = 0x55;
+    cpu.registers.pc = 0x0300;
+    cpu.Cycle();
+
+    REQUIRE(cpu.fused[0x06].handler == nullptr);
+    REQUIRE(cpu.fused[0x08].handler == nullptr);
+
+    // running it decodes the slot again and fuses what still matches
+    cpu.registers.pc = 0x020a;
+    cpu.Cycle();
+
+    REQUIRE(cpu.current_opcode == 0x00e0);
+    REQUIRE(cpu.fused[0x06].handler == nullptr);
+    REQUIRE(cpu.fused[0x0c].handler == &chip8::cpu::CPU::FusedLoadDraw);
+}
+
+TEST_CASE("fusion before a rom write is kept", "[cpu-class][engine]")
+{
+    chip8::cpu::CPU cpu(chip8::cpu::Engine::Predecoded);
+    cpu.LoadROM(fusion_rom.data(), fusion_rom.size());
+
+    // overwrite the skipped clear at 214, which never runs again
+    cpu.registers.index = 0x0214;
+    cpu.registers.variable[0] = 0x13;
+    cpu.registers.variable[1] = 0x00;
+    cpu.ram[0x0300] = 0xf1;
+    cpu.ram[0x0301] = 0x55;
+    cpu.registers.pc = 0x0300;
+    cpu.Cycle();
+
+    // the skip and jump at 210 don't read 214, they stay fused
+    REQUIRE(cpu.fused[0x10].handler == &chip8::cpu::CPU::FusedSkipJump);
+    REQUIRE(cpu.fused[0x12].handler == nullptr);
+    REQUIRE(cpu.fused[0x14].handler == nullptr);
+}
+
+#pragma endregion
+
+#pragma region idle
+
+const chip8::cpu::Engine all_engines[] =
+{
+    chip8::cpu::Engine::Interpreter, chip8::cpu::Engine::Predecoded, chip8::cpu::Engine::Table,
+    chip8::cpu::Engine::Threaded,    chip8::cpu::Engine::Jit
+};
+
+TEST_CASE("idle halt is skipped", "[cpu-class][engine]")
+{
+    const std::array<chip8::cpu::byte, 4> rom =
+    {
+        0x61, 0x07,     // 200: v[1] = 7
+        0x12, 0x02      // 202: jump 202
+    };
+
+    for (auto engine : all_engines)
+    {
+        chip8::cpu::CPU cpu(engine);
+        cpu.LoadROM(rom.data(), rom.size());
+        cpu.RunCycles(1000000000000);
+
+        REQUIRE(cpu.GetIdle() == chip8::cpu::Idle::Halted);
+        REQUIRE(cpu.registers.pc == 0x0202);
+        REQUIRE(cpu.current_opcode == 0x1202);
+        REQUIRE(cpu.registers.variable[1] == 7);
+    }
+}
+
+TEST_CASE("idle key wait is skipped", "[cpu-class][engine]")
+{
+    const std::array<chip8::cpu::byte, 4> rom =
+    {
+        0xf3, 0x0a,     // 200: v[3] = wait for key
+        0x12, 0x00      // 202: jump 200
+    };
+
+    for (auto engine : all_engines)
+    {
+        chip8::cpu::CPU cpu(engine);
+        cpu.LoadROM(rom.data(), rom.size());
+        cpu.RunCycles(1000000000000);
+
+        REQUIRE(cpu.GetIdle() == chip8::cpu::Idle::WaitingForKey);
+        REQUIRE(cpu.registers.pc == 0x0200);
+
+        cpu.keyboard[5] = 1;
+        cpu.RunCycles(1);
+
+        REQUIRE(cpu.GetIdle() == chip8::cpu::Idle::None);
+        REQUIRE(cpu.registers.variable[3] == 5);
+    }
+}
+
+TEST_CASE("idle timer poll matches interpreter", "[cpu-class][engine]")
+{
+    const std::array<chip8::cpu::byte, 10> rom =
+    {
+        0x62, 0x01,     // 200: v[2] = 1
+        0xf2, 0x07,     // 202: v[2] = delay
+        0x32, 0x00,     // 204: skip if v[2] == 0
+        0x12, 0x02,     // 206: jump 202
+        0x63, 0x09      // 208: v[3] = 9
+    };
+
+    for (auto engine : all_engines)
+    {
+        for (int cycles = 1; cycles < 20; cycles++)
+        {
+            chip8::cpu::CPU interpreter;
+            chip8::cpu::CPU other(engine);
+
+            interpreter.LoadROM(rom.data(), rom.size());
+            other.LoadROM(rom.data(), rom.size());
+            interpreter.registers.delay_timer = 30;
+            other.registers.delay_timer = 30;
+
+            for (int i = 0; i < cycles; i++)
+                interpreter.Cycle();
+            other.RunCycles(cycles);
+
+            INFO(int(engine) << " engine, " << cycles << " cycles");
+            REQUIRE(interpreter.current_opcode == other.current_opcode);
+            REQUIRE(interpreter.registers.pc == other.registers.pc);
+            REQUIRE(interpreter.registers.variable == other.registers.variable);
+        }
+
+        chip8::cpu::CPU cpu(engine);
+        cpu.LoadROM(rom.data(), rom.size());
+        cpu.registers.delay_timer = 30;
+        cpu.RunCycles(1000000000001);
+
+        REQUIRE(cpu.GetIdle() == chip8::cpu::Idle::WaitingForTimer);
+        REQUIRE(cpu.registers.variable[2] == 30);
+
+        // once the timer is out the loop exits
+        cpu.registers.delay_timer = 0;
+        cpu.RunCycles(5);
+
+        REQUIRE(cpu.GetIdle() == chip8::cpu::Idle::None);
+        REQUIRE(cpu.registers.variable[3] == 9);
+    }
+}
+
+TEST_CASE("idle timer poll entered mid loop reads the timer", "[cpu-class][engine]")
+{
+    const std::array<chip8::cpu::byte, 10> rom =
+    {
+        0x62, 0x01,     // 200: v[2] = 1
+        0xf2, 0x07,     // 202: v[2] = delay
+        0x32, 0x00,     // 204: skip if v[2] == 0
+        0x12, 0x02,     // 206: jump 202
+        0x63, 0x09      // 208: v[3] = 9
+    };
+
+    // v[2] is stale when a call starts at the 3x00 or the 1nnn, the poll
+    // has to run once before it's skipped
+    for (auto engine : all_engines)
+    {
+        for (chip8::cpu::word pc : { 0x0204, 0x0206 })
+        {
+            for (chip8::cpu::byte delay : { 0, 30 })
+            {
+                chip8::cpu::CPU interpreter;
+                chip8::cpu::CPU other(engine);
+
+                for (chip8::cpu::CPU* cpu : { &interpreter, &other })
+                {
+                    cpu->LoadROM(rom.data(), rom.size());
+                    cpu->registers.pc = pc;
+                    cpu->registers.variable[2] = 5;
+                    cpu->registers.delay_timer = delay;
+                }
+
+                for (int i = 0; i < 1000; i++)
+                    interpreter.Cycle();
+                other.RunCycles(1000);
+
+                INFO(int(engine) << " engine, pc " << pc << ", delay " << int(delay));
+                REQUIRE(interpreter.registers.pc == other.registers.pc);
+                REQUIRE(interpreter.registers.variable == other.registers.variable);
+                REQUIRE(other.registers.variable[2] == delay);
+            }
+        }
+    }
+}
+
+#pragma endregion
+
+#pragma region run
+
+TEST_CASE("run cycles status", "[cpu-class][engine]")
+{
+    const std::array<chip8::cpu::byte, 8> rom =
+    {
+        0x00, 0xe0,     // 200: clear
+        0x60, 0x05,     // 202: v[0] = 5
+        0xf3, 0x0a,     // 204: v[3] = key
+        0x12, 0x06      // 206: jump 206
+    };
+
+    for (auto engine : all_engines)
+    {
+        INFO(int(engine) << " engine");
+
+        chip8::cpu::CPU cpu(engine);
+        cpu.LoadROM(rom.data(), rom.size());
+
+        chip8::cpu::RunStatus status = cpu.RunCycles(2);
+        REQUIRE(status.cycles == 2);
+        REQUIRE(status.drew);
+        REQUIRE_FALSE(status.frame_end);
+        REQUIRE_FALSE(status.waiting_for_key);
+        REQUIRE_FALSE(status.fault);
+
+        status = cpu.RunCycles(100);
+        REQUIRE(status.cycles == 100);
+        REQUIRE_FALSE(status.drew);
+        REQUIRE(status.waiting_for_key);
+        REQUIRE(status.idle == chip8::cpu::Idle::WaitingForKey);
+    }
+}
+
+TEST_CASE("run cycles fault", "[cpu-class][engine]")
+{
+    const std::array<chip8::cpu::byte, 4> rom =
+    {
+        0x8a, 0xb8,     // 200: unknown
+        0x12, 0x02      // 202: jump 202
+    };
+
+    for (auto engine : all_engines)
+    {
+        INFO(int(engine) << " engine");
+
+        chip8::cpu::CPU cpu(engine);
+        cpu.LoadROM(rom.data(), rom.size());
+
+        REQUIRE(cpu.RunCycles(10).fault);
+        REQUIRE_FALSE(cpu.RunCycles(10).fault);
+    }
+}
+
+TEST_CASE("run frame ticks timers", "[cpu-class][engine]")
+{
+    for (auto engine : all_engines)
+    {
+        INFO(int(engine) << " engine");
+
+        chip8::cpu::CPU cpu(engine);
+        cpu.LoadROM(counter_rom.data(), counter_rom.size());
+        cpu.registers.delay_timer = 2;
+        cpu.registers.sound_timer = 1;
+
+        chip8::cpu::RunStatus status = cpu.RunFrame(10);
+        REQUIRE(status.frame_end);
+        REQUIRE(status.cycles == 10);
+        REQUIRE(cpu.registers.delay_timer == 1);
+        REQUIRE(cpu.registers.sound_timer == 0);
+
+        cpu.RunFrame(10);
+        cpu.RunFrame(10);
+        REQUIRE(cpu.registers.delay_timer == 0);
+        REQUIRE(cpu.registers.sound_timer == 0);
+    }
+}
+
+TEST_CASE("engine names", "[cpu-class][engine]")
+{
+    for (std::size_t i = 0; i < chip8::cpu::engine_count; i++)
+    {
+        chip8::cpu::Engine engine = chip8::cpu::Engine::Interpreter;
+        REQUIRE(chip8::cpu::ParseEngine(chip8::cpu::EngineName(chip8::cpu::Engine(i)), engine));
+        REQUIRE(engine == chip8::cpu::Engine(i));
+    }
+
+    chip8::cpu::Engine engine = chip8::cpu::Engine::Table;
+    REQUIRE(std::string(chip8::cpu::EngineName(chip8::cpu::Engine::Interpreter)) == "switch");
+    REQUIRE_FALSE(chip8::cpu::ParseEngine("all", engine));
+    REQUIRE(engine == chip8::cpu::Engine::Table);
+}
+
+#pragma endregion
+
+#pragma region batch
+
+// lanes holding key 4 take a different path through the loop and rejoin at 204
+const std::array<chip8::cpu::byte, 0x36> batch_rom =
+{
+    0x60, 0x00,     // 200: v[0] = 0
+    0x61, 0x05,     // 202: v[1] = 5
+    0x80, 0x14,     // 204: v[0] += v[1]
+    0x81, 0x06,     // 206: v[1] >>= 1
+    0x81, 0x0e,     // 208: v[1] <<= 1
+    0x82, 0x05,     // 20a: v[2] -= v[0]
+    0x83, 0x27,     // 20c: v[3] = v[2] - v[3]
+    0x71, 0x07,     // 20e: v[1] += 7
+    0x65, 0x04,     // 210: v[5] = 4
+    0xe5, 0x9e,     // 212: skip if key v[5]
+    0x12, 0x20,     // 214: jump 220
+    0x76, 0x01,     // 216: v[6] += 1
+    0xa3, 0x00,     // 218: I = 300
+    0xf6, 0x55,     // 21a: ram[I] = v[0..6]
+    0x22, 0x30,     // 21c: call 230
+    0x12, 0x04,     // 21e: jump 204
+    0x8f, 0x04,     // 220: v[f] += v[0]
+    0x90, 0x10,     // 222: skip if v[0] != v[1]
+    0x47, 0x00,     // 224: skip if v[7] != 0
+    0x77, 0x01,     // 226: v[7] += 1
+    0xf0, 0x29,     // 228: I = font v[0]
+    0xd1, 0x25,     // 22a: draw
+    0x12, 0x04,     // 22c: jump 204
+    0x00, 0x00,     // 22e:
+    0x51, 0x20,     // 230: skip if v[1] == v[2]
+    0x81, 0x23,     // 232: v[1] ^= v[2]
+    0x00, 0xee      // 234: return
+};
+
+template <std::size_t N>
+void RequireBatchMatchesInterpreter(chip8::cpu::Quirks quirks, int cycles)
+{
+    auto batch = std::make_unique<chip8::cpu::CPUBatch<N>>(quirks);
+    batch->LoadROM(batch_rom.data(), batch_rom.size());
+    for (std::size_t lane = 1; lane < N; lane += 2)
+        batch->SetKey(lane, 4, true);
+
+    batch->RunCycles(cycles);
+    batch->TickTimers();
+
+    for (std::size_t lane = 0; lane < N; lane++)
+    {
+        chip8::cpu::CPU interpreter(chip8::cpu::Engine::Interpreter, quirks);
+        interpreter.LoadROM(batch_rom.data(), batch_rom.size());
+        interpreter.keyboard[4] = lane % 2;
+
+        for (int i = 0; i < cycles; i++)
+            interpreter.Cycle();
+
+        const chip8::cpu::CPU& other = batch->Lane(lane);
+
+        INFO("lane " << lane);
+        REQUIRE(interpreter.registers.pc == other.registers.pc);
+        REQUIRE(interpreter.registers.index == other.registers.index);
+        REQUIRE(interpreter.registers.variable == other.registers.variable);
+        REQUIRE(interpreter.registers.stack_pointer == other.registers.stack_pointer);
+        REQUIRE(interpreter.ram == other.ram);
+        REQUIRE(interpreter.vram == other.vram);
+    }
+
+    REQUIRE(batch->LockstepLanes() > 0);
+    REQUIRE(batch->LockstepLanes() + batch->ScalarLanes() == N * cycles);
+
+    // by then the key lanes have split off at least once
+    if (cycles >= 50)
+        REQUIRE(batch->ScalarLanes() > 0);
+}
+
+TEST_CASE("batch matches interpreter", "[cpu-class][engine]")
+{
+    chip8::cpu::Quirks super_chip;
+    super_chip.super_chip = true;
+
+    for (int cycles : { 1, 7, 50, 1000 })
+    {
+        INFO(cycles << " cycles");
+        RequireBatchMatchesInterpreter<16>(chip8::cpu::Quirks(), cycles);
+        RequireBatchMatchesInterpreter<32>(super_chip, cycles);
+        RequireBatchMatchesInterpreter<64>(chip8::cpu::Quirks(), cycles);
+    }
+}
+
+TEST_CASE("batch ticks timers", "[cpu-class][engine]")
+{
+    auto batch = std::make_unique<chip8::cpu::CPUBatch<16>>();
+    batch->delay_timer[3] = 2;
+    batch->sound_timer[3] = 1;
+    batch->TickTimers();
+
+    REQUIRE(batch->Lane(3).registers.delay_timer == 1);
+    REQUIRE(batch->Lane(3).registers.sound_timer == 0);
+    REQUIRE(batch->Lane(0).registers.delay_timer == 0);
+}
+
+#pragma endregion
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <vector>
+
+#include "../env/environment.hpp"
+
+#pragma region env
+
+namespace
+{
+
+// draws a 0, counts v[0] into ram[300] until key 0 halts it
+const std::array<chip8::cpu::byte, 0x0e> env_rom =
+{
+    0xd1, 0x15,     // 200: draw font 0 at 0, 0
+    0xa3, 0x00,     // 202: I = 300
+    0x70, 0x01,     // 204: v[0] += 1
+    0xf0, 0x55,     // 206: ram[I] = v[0]
+    0xe1, 0x9e,     // 208: skip if key v[1] is pressed
+    0x12, 0x04,     // 20a: jump 204
+    0x12, 0x0c      // 20c: halt
+};
+
+float Score(void*, std::size_t, const chip8::cpu::CPU& cpu)
+{
+    return cpu.GetRAM().Read(0x300);
+}
+
+bool Halted(void*, std::size_t, const chip8::cpu::CPU& cpu)
+{
+    return cpu.GetIdle() == chip8::cpu::Idle::Halted;
+}
+
+chip8::env::Config MakeConfig()
+{
+    chip8::env::Config config;
+    config.frame_skip = 2;
+    config.instructions_per_frame = 9;
+    config.reward = Score;
+    config.done = Halted;
+    return config;
+}
+
+}
+
+TEST_CASE("env steps every instance", "[env]")
+{
+    const std::size_t size = 4;
+    chip8::env::VectorEnv env(size, env_rom.data(), env_rom.size(), MakeConfig());
+    REQUIRE(env.Size() == size);
+
+    std::vector<chip8::cpu::byte> observations(size * chip8::env::VectorEnv::observation_size, 0xff);
+    env.Reset(observations.data());
+    for (auto pixel : observations)
+        REQUIRE(pixel == 0);
+
+    std::array<uint16_t, size> keys = { 0, 0, 1, 0 };
+    std::array<float, size> rewards;
+    std::array<chip8::cpu::byte, size> dones;
+    env.Step(keys.data(), observations.data(), rewards.data(), dones.data());
+
+    // the instance holding key 0 halted and started over
+    REQUIRE(dones == std::array<chip8::cpu::byte, size>({ 0, 0, 1, 0 }));
+    REQUIRE(env.Instance(2).GetRegisters().pc == 0x200);
+    REQUIRE(observations[2 * chip8::env::VectorEnv::observation_size] == 0);
+
+    // the count is 2 after the first frame and 4 after the second
+    for (std::size_t instance : { 0, 1, 3 })
+    {
+        INFO(instance);
+        REQUIRE(rewards[instance] == 2 + 4);
+        REQUIRE(observations[instance * chip8::env::VectorEnv::observation_size] == 1);
+        REQUIRE(env.Instance(instance).GetRAM().Read(0x300) == 4);
+    }
+}
+
+TEST_CASE("env cuts episodes at max frames", "[env]")
+{
+    chip8::env::Config config = MakeConfig();
+    config.max_frames = 5;
+    config.seed = 3;
+    chip8::env::VectorEnv env(2, env_rom.data(), env_rom.size(), config);
+
+    std::vector<chip8::cpu::byte> observations(2 * chip8::env::VectorEnv::observation_size);
+    std::array<uint16_t, 2> keys = { 0, 0 };
+    std::array<float, 2> rewards;
+    std::array<chip8::cpu::byte, 2> dones;
+
+    env.Step(keys.data(), observations.data(), rewards.data(), dones.data());
+    env.Step(keys.data(), observations.data(), rewards.data(), dones.data());
+    REQUIRE(dones[0] == 0);
+
+    // the fifth frame ends the episode part way through the step
+    env.Step(keys.data(), observations.data(), rewards.data(), dones.data());
+    REQUIRE(dones[0] == 1);
+    REQUIRE(dones[1] == 1);
+    REQUIRE(env.Instance(0).GetRAM().Read(0x300) == 0);
+
+    // every episode gets its own seed
+    REQUIRE(env.Instance(0).GetSeed() != env.Instance(1).GetSeed());
+}
+
+#pragma endregion
\ No newline at end of file
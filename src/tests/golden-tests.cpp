@@ -0,0 +1,126 @@
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+
+#include "../farm/golden.hpp"
+
+#pragma region golden
+
+namespace
+{
+
+// draws a digit that moves right every frame, key 3 changes the digit
+const std::array<chip8::cpu::byte, 0x14> golden_rom =
+{
+    0x00, 0xe0,     // 200: clear
+    0x60, 0x00,     // 202: v[0] = 0
+    0x63, 0x03,     // 204: v[3] = 3
+    0xf2, 0x29,     // 206: I = font v[2]
+    0xd0, 0x15,     // 208: draw
+    0x70, 0x01,     // 20a: v[0] += 1
+    0xe3, 0xa1,     // 20c: skip if key v[3] isn't pressed
+    0x72, 0x01,     // 20e: v[2] += 1
+    0x12, 0x06,     // 210: jump 206
+    0x00, 0x00
+};
+
+const char* const rom_path = "golden-tests.ch8";
+const char* const manifest_path = "golden-tests.txt";
+
+void WriteROM()
+{
+    std::ofstream rom(rom_path, std::ios::binary);
+    rom.write(reinterpret_cast<const char*>(golden_rom.data()), golden_rom.size());
+}
+
+chip8::farm::Trace MakeTrace()
+{
+    chip8::farm::Trace trace;
+    trace.rom = rom_path;
+    trace.frames = 30;
+    trace.instructions_per_frame = 7;
+    trace.keys = { { 10, 3, true }, { 12, 3, false } };
+    trace.checkpoints = { { 0, 0 }, { 5, 0 }, { 11, 0 }, { 30, 0 } };
+    return trace;
+}
+
+}
+
+TEST_CASE("golden manifest round trip", "[farm][golden]")
+{
+    chip8::farm::Trace trace = MakeTrace();
+    trace.seed = 77;
+    trace.quirks.super_chip = true;
+    trace.checkpoints[1].hash = 0x0123456789abcdef;
+
+    REQUIRE(chip8::farm::SaveManifest(manifest_path, { trace, MakeTrace() }));
+
+    std::vector<chip8::farm::Trace> traces;
+    std::string error;
+    REQUIRE(chip8::farm::LoadManifest(manifest_path, traces, error));
+    std::remove(manifest_path);
+
+    REQUIRE(traces.size() == 2);
+    REQUIRE(traces[0].rom == trace.rom);
+    REQUIRE(traces[0].frames == 30);
+    REQUIRE(traces[0].instructions_per_frame == 7);
+    REQUIRE(traces[0].seed == 77);
+    REQUIRE(traces[0].quirks.super_chip);
+    REQUIRE(traces[0].quirks.new_store_load);
+    REQUIRE(traces[0].keys.size() == 2);
+    REQUIRE(traces[0].keys[1].frame == 12);
+    REQUIRE_FALSE(traces[0].keys[1].down);
+    REQUIRE(traces[0].checkpoints.size() == 4);
+    REQUIRE(traces[0].checkpoints[1].hash == 0x0123456789abcdef);
+    REQUIRE_FALSE(traces[1].quirks.super_chip);
+}
+
+TEST_CASE("golden manifest errors", "[farm][golden]")
+{
+    std::ofstream(manifest_path) << "frames 10\n";
+
+    std::vector<chip8::farm::Trace> traces;
+    std::string error;
+    REQUIRE_FALSE(chip8::farm::LoadManifest(manifest_path, traces, error));
+    REQUIRE(error.find(":1:") != std::string::npos);
+    std::remove(manifest_path);
+}
+
+TEST_CASE("golden hashes match on every engine", "[farm][golden]")
+{
+    WriteROM();
+
+    std::vector<chip8::farm::Trace> traces = { MakeTrace() };
+    chip8::farm::TraceResult golden = chip8::farm::RunTrace(traces[0], chip8::cpu::Engine::Interpreter);
+
+    REQUIRE(golden.loaded);
+    REQUIRE(golden.hashes.size() == 4);
+    REQUIRE(golden.hashes[1] != golden.hashes[0]);
+    REQUIRE(golden.hashes[3] != golden.hashes[2]);
+
+    for (std::size_t i = 0; i < golden.hashes.size(); i++)
+        traces[0].checkpoints[i].hash = golden.hashes[i];
+
+    const chip8::cpu::Engine engines[] =
+    {
+        chip8::cpu::Engine::Interpreter, chip8::cpu::Engine::Predecoded, chip8::cpu::Engine::Table,
+        chip8::cpu::Engine::Threaded,    chip8::cpu::Engine::Jit
+    };
+
+    for (auto engine : engines)
+    {
+        auto results = chip8::farm::RunTraces(traces, engine, 2);
+        INFO(int(engine) << " engine");
+        REQUIRE(chip8::farm::Matches(traces[0], results[0]));
+    }
+
+    // without the key press the screen ends up different
+    traces[0].keys.clear();
+    REQUIRE_FALSE(chip8::farm::Matches(traces[0], chip8::farm::RunTrace(traces[0], chip8::cpu::Engine::Interpreter)));
+
+    std::remove(rom_path);
+}
+
+#pragma endregion
\ No newline at end of file
@@ -10,7 +10,7 @@
 TEST_CASE("00e0 clear screen", "[cpu-class][op]")
 {
     chip8::cpu::CPU cpu;
-    std::fill(cpu.vram.begin(), cpu.vram.end(), 1);
+    cpu.vram.fill(~uint64_t(0));
 
     SECTION("set all pixels to on")
     {
@@ -46,6 +46,21 @@ TEST_CASE("00ee return", "[cpu-class][op]")
 
     REQUIRE(cpu.registers.stack_pointer == 0);
     REQUIRE(cpu.registers.pc == 0x333);
+    REQUIRE(cpu.GetLastFault() == chip8::cpu::Fault::None);
+}
+
+TEST_CASE("00ee return underflow", "[cpu-class][op]")
+{
+    chip8::cpu::CPU cpu;
+
+    cpu.ram[0x0200] = 0x00;
+    cpu.ram[0x0201] = 0xee;
+    cpu.Cycle();
+
+    REQUIRE(cpu.registers.stack_pointer == 0);
+    REQUIRE(cpu.registers.pc == 0x0202);
+    REQUIRE(cpu.GetLastFault() == chip8::cpu::Fault::StackUnderflow);
+    REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::StackUnderflow) == 1);
 }
 
 TEST_CASE("1nnn jump", "[cpu-class][op]")
@@ -74,6 +89,21 @@ TEST_CASE("2nnn call", "[cpu-class][op]")
     REQUIRE(cpu.stack[0] == 0x0202);
 }
 
+TEST_CASE("2nnn call overflow", "[cpu-class][op]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.registers.stack_pointer = 16;
+
+    cpu.ram[0x200] = 0x25;
+    cpu.ram[0x201] = 0x11;
+    cpu.Cycle();
+
+    REQUIRE(cpu.registers.pc == 0x0202);
+    REQUIRE(cpu.registers.stack_pointer == 16);
+    REQUIRE(cpu.GetLastFault() == chip8::cpu::Fault::StackOverflow);
+    REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::StackOverflow) == 1);
+}
+
 TEST_CASE("3xnn skip if equal const", "[cpu-class][op]")
 {
     chip8::cpu::CPU cpu;
@@ -359,7 +389,9 @@ TEST_CASE("8xy6 shr", "[cpu-class][op]")
 
     SECTION("super_chip")
     {
-        cpu.super_chip = true;
+        chip8::cpu::Quirks quirks;
+        quirks.super_chip = true;
+        cpu.SetQuirks(quirks);
         cpu.registers.variable[2] = 4;
         cpu.Cycle();
 
@@ -393,7 +425,9 @@ TEST_CASE("8xye shr", "[cpu-class][op]")
 
     SECTION("super_chip")
     {
-        cpu.super_chip = true;
+        chip8::cpu::Quirks quirks;
+        quirks.super_chip = true;
+        cpu.SetQuirks(quirks);
         cpu.registers.variable[2] = 4;
         cpu.Cycle();
 
@@ -438,13 +472,142 @@ TEST_CASE("bnnn jump off", "[cpu-class][op]")
     SECTION("super_chip")
     {
         cpu.registers.variable[4] = 0x02;
-        cpu.super_chip = true;
+        chip8::cpu::Quirks quirks;
+        quirks.super_chip = true;
+        cpu.SetQuirks(quirks);
         cpu.Cycle();
 
         REQUIRE(cpu.registers.pc == 0x04c5);
     }
 }
 
+TEST_CASE("cxnn random", "[cpu-class][op]")
+{
+    chip8::cpu::CPU a;
+    chip8::cpu::CPU b;
+    a.Seed(1234);
+    b.Seed(1234);
+
+    a.ram[0x0200] = b.ram[0x0200] = 0xc1;
+    a.ram[0x0201] = b.ram[0x0201] = 0x0f;
+    a.ram[0x0202] = b.ram[0x0202] = 0x12;
+    a.ram[0x0203] = b.ram[0x0203] = 0x00;
+
+    SECTION("same seed gives the same numbers")
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            a.Cycle();
+            b.Cycle();
+
+            REQUIRE(a.registers.variable[1] == b.registers.variable[1]);
+            REQUIRE(a.registers.variable[1] <= 0x0f);
+        }
+
+        REQUIRE(a.GetSeed() == 1234);
+    }
+
+    SECTION("different seeds give different numbers")
+    {
+        b.Seed(4321);
+
+        int same = 0;
+        for (int i = 0; i < 100; i++)
+        {
+            a.Cycle();
+            b.Cycle();
+            same += a.registers.variable[1] == b.registers.variable[1];
+        }
+
+        REQUIRE(same < 50);
+    }
+}
+
+TEST_CASE("dxyn draw", "[cpu-class][op]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.registers.index = 0x0300;
+    cpu.ram[0x0300] = 0xc3;
+    cpu.ram[0x0301] = 0x81;
+    cpu.ram[0x0302] = 0xff;
+
+    cpu.ram[0x0200] = 0xd0;
+    cpu.ram[0x0201] = 0x13;
+
+    SECTION("rows come from consecutive bytes")
+    {
+        cpu.registers.variable[0] = 4;
+        cpu.registers.variable[1] = 2;
+        cpu.Cycle();
+
+        REQUIRE(cpu.vram[2] == uint64_t(0xc3) << 52);
+        REQUIRE(cpu.vram[3] == uint64_t(0x81) << 52);
+        REQUIRE(cpu.vram[4] == uint64_t(0xff) << 52);
+        REQUIRE(cpu.GetPixel(4, 2));
+        REQUIRE_FALSE(cpu.GetPixel(6, 2));
+        REQUIRE(cpu.registers.variable[0x0f] == 0);
+    }
+
+    SECTION("drawing twice erases and sets v[f]")
+    {
+        cpu.ram[0x0202] = 0xd0;
+        cpu.ram[0x0203] = 0x13;
+        cpu.Cycle();
+        cpu.Cycle();
+
+        for (auto row : cpu.vram)
+            REQUIRE(row == 0);
+        REQUIRE(cpu.registers.variable[0x0f] == 1);
+    }
+
+    SECTION("start wraps and the edges clip")
+    {
+        cpu.registers.variable[0] = 64 + 60;
+        cpu.registers.variable[1] = 32 + 30;
+        cpu.Cycle();
+
+        REQUIRE(cpu.vram[30] == 0x0c);
+        REQUIRE(cpu.vram[31] == 0x08);
+        REQUIRE(cpu.vram[0] == 0);
+    }
+}
+
+TEST_CASE("dxyn and 00e0 mark dirty rows and columns", "[cpu-class][op]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.registers.index = 0x0300;
+    cpu.registers.variable[0] = 4;
+    cpu.registers.variable[1] = 2;
+    cpu.ram[0x0300] = 0xc3;
+    cpu.ram[0x0301] = 0x00;
+    cpu.ram[0x0302] = 0x18;
+
+    cpu.ram[0x0200] = 0xd0;
+    cpu.ram[0x0201] = 0x13;
+    cpu.ram[0x0202] = 0x00;
+    cpu.ram[0x0203] = 0xe0;
+    cpu.ram[0x0204] = 0x12;
+    cpu.ram[0x0205] = 0x04;
+
+    // the empty middle row changes nothing
+    cpu.Cycle();
+    REQUIRE(cpu.GetDirtyRows() == 0x14);
+    REQUIRE(cpu.GetDirtyColumns() == uint64_t(0xdb) << 52);
+
+    cpu.ClearDirty();
+    cpu.Cycle();
+    REQUIRE(cpu.GetDirtyRows() == 0x14);
+    REQUIRE(cpu.GetDirtyColumns() == uint64_t(0xdb) << 52);
+
+    // a frame that doesn't draw leaves nothing dirty
+    cpu.RunFrame(10);
+    REQUIRE(cpu.GetDirtyRows() == 0);
+    REQUIRE(cpu.GetDirtyColumns() == 0);
+
+    cpu.Reset();
+    REQUIRE(cpu.GetDirtyRows() == 0xffffffff);
+}
+
 TEST_CASE("ex9e skip key", "[cpu-class][op]")
 {
     chip8::cpu::CPU cpu;
@@ -546,6 +709,7 @@ TEST_CASE("fx1e i += v[x]", "[cpu-class][op]")
 
         REQUIRE(cpu.registers.index == 0x305);
         REQUIRE(cpu.registers.variable[0x0f] == 0);
+        REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::IndexOverflow) == 0);
     }
 
     SECTION("carry")
@@ -555,6 +719,7 @@ TEST_CASE("fx1e i += v[x]", "[cpu-class][op]")
 
         REQUIRE(cpu.registers.index == 0x1004);
         REQUIRE(cpu.registers.variable[0x0f] == 1);
+        REQUIRE(cpu.GetFaultCount(chip8::cpu::Fault::IndexOverflow) == 1);
     }
 }
 
@@ -623,7 +788,9 @@ TEST_CASE("fx55 ld to ram", "[cpu-class][op]")
 
     SECTION("new")
     {
-        cpu.new_store_load = true;
+        chip8::cpu::Quirks quirks;
+        quirks.new_store_load = true;
+        cpu.SetQuirks(quirks);
         cpu.Cycle();
 
         REQUIRE(cpu.ram[0x0300] == 0x15);
@@ -635,7 +802,9 @@ TEST_CASE("fx55 ld to ram", "[cpu-class][op]")
 
     SECTION("old")
     {
-        cpu.new_store_load = false;
+        chip8::cpu::Quirks quirks;
+        quirks.new_store_load = false;
+        cpu.SetQuirks(quirks);
         cpu.Cycle();
 
         REQUIRE(cpu.ram[0x0300] == 0x15);
@@ -660,7 +829,9 @@ TEST_CASE("fx65 ld to reg", "[cpu-class][op]")
 
     SECTION("new")
     {
-        cpu.new_store_load = true;
+        chip8::cpu::Quirks quirks;
+        quirks.new_store_load = true;
+        cpu.SetQuirks(quirks);
         cpu.Cycle();
 
         REQUIRE(cpu.registers.variable[0] == 0x15);
@@ -672,7 +843,9 @@ TEST_CASE("fx65 ld to reg", "[cpu-class][op]")
 
     SECTION("old")
     {
-        cpu.new_store_load = false;
+        chip8::cpu::Quirks quirks;
+        quirks.new_store_load = false;
+        cpu.SetQuirks(quirks);
         cpu.Cycle();
 
         REQUIRE(cpu.registers.variable[0] == 0x15);
@@ -684,3 +857,87 @@ TEST_CASE("fx65 ld to reg", "[cpu-class][op]")
 }
 
 #pragma endregion
+
+#pragma region bounds
+
+// every address wraps at 0x1000 and every key index at 16, the handlers
+// never read or write outside their arrays
+TEST_CASE("fetch wraps at end of ram", "[cpu-class][bounds]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.registers.pc = 0x0fff;
+    cpu.ram[0x0fff] = 0x61;
+    cpu.ram[0x0000] = 0x23;
+    cpu.Cycle();
+
+    REQUIRE(cpu.current_opcode == 0x6123);
+    REQUIRE(cpu.registers.variable[1] == 0x23);
+}
+
+TEST_CASE("fx55 fx65 wrap at end of ram", "[cpu-class][bounds]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.registers.index = 0x0ffe;
+    cpu.registers.variable = { 1, 2, 3, 4 };
+
+    cpu.ram[0x0200] = 0xf3;
+    cpu.ram[0x0201] = 0x55;
+    cpu.ram[0x0202] = 0x60;
+    cpu.ram[0x0203] = 0x00;
+    cpu.ram[0x0204] = 0xf3;
+    cpu.ram[0x0205] = 0x65;
+    cpu.Cycle();
+
+    REQUIRE(cpu.ram[0x0ffe] == 1);
+    REQUIRE(cpu.ram[0x0fff] == 2);
+    REQUIRE(cpu.ram[0x0000] == 3);
+    REQUIRE(cpu.ram[0x0001] == 4);
+
+    cpu.Cycle();
+    cpu.Cycle();
+    REQUIRE(cpu.registers.variable[0] == 1);
+    REQUIRE(cpu.registers.variable[2] == 3);
+}
+
+TEST_CASE("dxyn and fx33 wrap past index overflow", "[cpu-class][bounds]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.registers.index = 0x1004;
+    cpu.registers.variable[1] = 123;
+
+    cpu.ram[0x0200] = 0xf1;
+    cpu.ram[0x0201] = 0x33;
+    cpu.ram[0x0202] = 0xd0;
+    cpu.ram[0x0203] = 0x01;
+    cpu.Cycle();
+
+    REQUIRE(cpu.ram[0x0004] == 1);
+    REQUIRE(cpu.ram[0x0005] == 2);
+    REQUIRE(cpu.ram[0x0006] == 3);
+
+    // draws the first row of the byte at 0x004
+    cpu.Cycle();
+    REQUIRE(cpu.GetPixel(0, 0) == 0);
+    REQUIRE(cpu.GetPixel(7, 0) == 1);
+}
+
+TEST_CASE("ex9e exa1 wrap key index", "[cpu-class][bounds]")
+{
+    chip8::cpu::CPU cpu;
+    cpu.keyboard[2] = 1;
+    cpu.registers.variable[1] = 0x12;
+
+    cpu.ram[0x0200] = 0xe1;
+    cpu.ram[0x0201] = 0x9e;
+    cpu.Cycle();
+
+    REQUIRE(cpu.registers.pc == 0x0204);
+
+    cpu.ram[0x0204] = 0xe1;
+    cpu.ram[0x0205] = 0xa1;
+    cpu.Cycle();
+
+    REQUIRE(cpu.registers.pc == 0x0206);
+}
+
+#pragma endregion
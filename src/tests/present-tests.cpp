@@ -0,0 +1,280 @@
+#include <catch2/catch.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <random>
+#include <vector>
+
+#include "../graphics/headless.hpp"
+#include "../graphics/present.hpp"
+#include "../graphics/triple-buffer.hpp"
+
+#pragma region present
+
+namespace
+{
+
+chip8::cpu::Framebuffer RandomScreen(unsigned seed)
+{
+    std::mt19937_64 generator(seed);
+    chip8::cpu::Framebuffer vram;
+    for (auto& row : vram)
+        row = generator();
+    return vram;
+}
+
+// one pixel at a time, what the simd paths have to match
+std::vector<uint8_t> Reference(const chip8::cpu::Framebuffer& vram, chip8::graphics::PixelFormat format,
+                               const chip8::graphics::Palette& palette, std::size_t scale, std::size_t stride)
+{
+    std::size_t bytes = chip8::graphics::BytesPerPixel(format);
+    std::vector<uint8_t> out(32 * scale * stride, 0xcd);
+
+    for (std::size_t y = 0; y < 32 * scale; y++)
+    {
+        for (std::size_t x = 0; x < 64 * scale; x++)
+        {
+            bool on = (vram[y / scale] >> (63 - x / scale)) & 1;
+            chip8::graphics::Color color = on ? palette.on : palette.off;
+            uint8_t* pixel = &out[y * stride + x * bytes];
+
+            if (format == chip8::graphics::PixelFormat::RGBA32)
+            {
+                const uint8_t rgba[4] = { color.r, color.g, color.b, color.a };
+                std::memcpy(pixel, rgba, 4);
+            }
+            else if (format == chip8::graphics::PixelFormat::RGB565)
+            {
+                uint16_t rgb = ((color.r >> 3) << 11) | ((color.g >> 2) << 5) | (color.b >> 3);
+                std::memcpy(pixel, &rgb, 2);
+            }
+            else
+                *pixel = on ? palette.on_index : palette.off_index;
+        }
+    }
+    return out;
+}
+
+}
+
+TEST_CASE("expand matches reference", "[graphics][present]")
+{
+    chip8::graphics::Palette palette;
+    palette.off = { 0x12, 0x34, 0x56, 0x78 };
+    palette.on = { 0xfe, 0xdc, 0xba, 0x98 };
+    palette.off_index = 7;
+    palette.on_index = 200;
+
+    const chip8::graphics::PixelFormat formats[] =
+    {
+        chip8::graphics::PixelFormat::RGBA32, chip8::graphics::PixelFormat::RGB565,
+        chip8::graphics::PixelFormat::Indexed8
+    };
+
+    for (auto format : formats)
+    {
+        for (std::size_t scale = 1; scale <= 5; scale++)
+        {
+            // rows padded past their pixels, the padding must be left alone
+            std::size_t stride = 64 * scale * chip8::graphics::BytesPerPixel(format) + 12;
+            chip8::cpu::Framebuffer vram = RandomScreen(unsigned(scale));
+            vram[0] = 0x8000000000000001;
+
+            std::vector<uint8_t> out(32 * scale * stride, 0xcd);
+            chip8::graphics::Expand(vram, format, palette, scale, out.data(), stride);
+
+            INFO(int(format) << " format, scale " << scale);
+            REQUIRE(out == Reference(vram, format, palette, scale, stride));
+        }
+    }
+}
+
+TEST_CASE("expand default palette", "[graphics][present]")
+{
+    chip8::cpu::Framebuffer vram = {};
+    vram[1] = uint64_t(1) << 62;
+
+    std::vector<uint8_t> out(64 * 32 * 4);
+    chip8::graphics::Expand(vram, chip8::graphics::PixelFormat::RGBA32, chip8::graphics::Palette(), 1, out.data(), 64 * 4);
+
+    // pixel 1 of row 1 is white, everything else black
+    REQUIRE(out[(64 + 1) * 4] == 255);
+    REQUIRE(out[(64 + 1) * 4 + 3] == 255);
+    REQUIRE(out[(64 + 2) * 4] == 0);
+    REQUIRE(out[3] == 255);
+}
+
+TEST_CASE("expand only dirty rows", "[graphics][present]")
+{
+    chip8::cpu::Framebuffer vram;
+    vram.fill(~uint64_t(0));
+
+    std::vector<uint8_t> out(64 * 2 * 32 * 2, 9);
+    chip8::graphics::Expand(vram, chip8::graphics::PixelFormat::Indexed8, chip8::graphics::Palette(), 2,
+                            out.data(), 64 * 2, 0x80000001);
+
+    for (std::size_t y = 0; y < 64; y++)
+    {
+        INFO(y);
+        bool dirty = y < 2 || y >= 62;
+        REQUIRE(out[y * 128] == (dirty ? 1 : 9));
+        REQUIRE(out[y * 128 + 127] == (dirty ? 1 : 9));
+    }
+}
+
+#pragma endregion
+
+
+#pragma region handoff
+
+TEST_CASE("triple buffer hands over whole frames", "[graphics][handoff]")
+{
+    chip8::graphics::TripleBuffer<chip8::graphics::Frame> buffer;
+    REQUIRE_FALSE(buffer.Update());
+
+    const uint64_t frames = 200000;
+    std::thread producer([&]()
+    {
+        for (uint64_t number = 1; number <= frames; number++)
+        {
+            chip8::graphics::Frame& frame = buffer.Back();
+            frame.vram.fill(number);
+            frame.number = number;
+            buffer.Publish();
+        }
+    });
+
+    // every frame seen is complete and newer than the last one
+    uint64_t last = 0;
+    std::size_t torn = 0;
+    while (last < frames)
+    {
+        if (!buffer.Update())
+            continue;
+
+        const chip8::graphics::Frame& frame = buffer.Front();
+        for (auto row : frame.vram)
+            torn += row != frame.number;
+        REQUIRE(frame.number > last);
+        last = frame.number;
+    }
+
+    producer.join();
+    REQUIRE(torn == 0);
+    REQUIRE_FALSE(buffer.Update());
+}
+
+TEST_CASE("capture frame", "[graphics][handoff]")
+{
+    // draws the 0 from the font
+    const chip8::cpu::byte rom[] = { 0xd0, 0x05 };
+    chip8::cpu::CPU cpu;
+    cpu.LoadROM(rom, sizeof(rom));
+    cpu.RunFrame(1);
+
+    chip8::graphics::TripleBuffer<chip8::graphics::Frame> buffer;
+    chip8::graphics::Capture(cpu, 1, buffer.Back());
+    buffer.Publish();
+
+    REQUIRE(buffer.Update());
+    REQUIRE(buffer.Front().vram == cpu.GetVRAM());
+    REQUIRE(buffer.Front().dirty_rows == 0x1f);
+    REQUIRE(buffer.Front().number == 1);
+}
+
+#pragma endregion
+
+
+#pragma region headless
+
+namespace
+{
+
+chip8::graphics::Frame MakeFrame(uint64_t number)
+{
+    chip8::graphics::Frame frame;
+    frame.vram = RandomScreen(unsigned(number));
+    frame.number = number;
+    return frame;
+}
+
+std::vector<uint8_t> ReadFile(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+bool Count(void* user, const chip8::graphics::Frame& frame)
+{
+    *static_cast<uint64_t*>(user) += frame.number;
+    return true;
+}
+
+}
+
+TEST_CASE("raw stream writes packed rows", "[graphics][headless]")
+{
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+
+    chip8::graphics::RawStream stream(file);
+    chip8::graphics::Frame first = MakeFrame(1);
+    chip8::graphics::Frame second = MakeFrame(2);
+    REQUIRE(stream.Present(first));
+    REQUIRE(stream.Present(second));
+
+    std::vector<uint8_t> written(2 * sizeof(chip8::cpu::Framebuffer));
+    std::rewind(file);
+    REQUIRE(std::fread(written.data(), 1, written.size() + 1, file) == written.size());
+    REQUIRE(std::memcmp(written.data(), first.vram.data(), sizeof(first.vram)) == 0);
+    REQUIRE(std::memcmp(written.data() + sizeof(first.vram), second.vram.data(), sizeof(second.vram)) == 0);
+    std::fclose(file);
+}
+
+TEST_CASE("image sequence writes pgm and pbm", "[graphics][headless]")
+{
+    chip8::graphics::Frame frame = MakeFrame(7);
+
+    chip8::graphics::ImageSequence pgm("headless-tests-", chip8::graphics::ImageFormat::PGM, 2);
+    REQUIRE(pgm.Present(frame));
+
+    std::vector<uint8_t> image = ReadFile("headless-tests-000007.pgm");
+    const std::string header = "P5\n128 64\n255\n";
+    REQUIRE(image.size() == header.size() + 128 * 64);
+    REQUIRE(std::equal(header.begin(), header.end(), image.begin()));
+
+    std::vector<uint8_t> pixels(image.begin() + header.size(), image.end());
+    chip8::graphics::Palette levels;
+    levels.off_index = 0;
+    levels.on_index = 255;
+    REQUIRE(pixels == Reference(frame.vram, chip8::graphics::PixelFormat::Indexed8, levels, 2, 128));
+
+    chip8::graphics::ImageSequence pbm("headless-tests-", chip8::graphics::ImageFormat::PBM, 3);
+    REQUIRE(pbm.Present(frame));
+
+    // lit pixels are white, a clear bit in pbm
+    image = ReadFile("headless-tests-000007.pbm");
+    REQUIRE(image.size() == 9 + 256);
+    REQUIRE(image[9] == uint8_t(~frame.vram[0] >> 56));
+    REQUIRE(image[9 + 15] == uint8_t(~frame.vram[1]));
+
+    std::remove("headless-tests-000007.pgm");
+    std::remove("headless-tests-000007.pbm");
+}
+
+TEST_CASE("callback backend", "[graphics][headless]")
+{
+    uint64_t total = 0;
+    chip8::graphics::CallbackBackend backend(Count, &total);
+
+    std::unique_ptr<chip8::graphics::Backend> generic(new chip8::graphics::CallbackBackend(Count, &total));
+    REQUIRE(backend.Present(MakeFrame(3)));
+    REQUIRE(generic->Present(MakeFrame(4)));
+    REQUIRE(total == 7);
+}
+
+#pragma endregion
\ No newline at end of file